@@ -0,0 +1,558 @@
+/**
+ * @file bench.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Headless microbenchmarks of the buffer, editor, syntax, configuration and rendering code.
+ * 
+ * Built and run by `make bench`, results are written to stdout as JSON.
+*/
+
+#include <editor/buffer/buffer.h>
+#include <editor/buffer/editor.h>
+#include <editor/syntax/syntax.h>
+#include <editor/config.h>
+
+#include <interface/screens/editor_scr.h>
+#include <interface/interface.h>
+
+#include <global.h>
+#include <util.h>
+#include <includes.h>
+
+#include <limits.h>
+
+/// The number of lines in the generated file, unless one is given.
+#define AS_BENCH_DEFAULT_LINES 100000
+/// The number of times whole file operations are repeated, unless a number is given.
+#define AS_BENCH_DEFAULT_ITERATIONS 5
+/// The number of characters typed and deleted by the editing benchmarks.
+#define AS_BENCH_CHARS 100000
+/// The number of lines split, joined and moved by the editing benchmarks.
+#define AS_BENCH_ROWS 10000
+/// The number of frames rendered for each file size by the render benchmark.
+#define AS_BENCH_FRAMES 1000
+
+FILE *__AS_DBG_LOG_FILE__ = NULL;
+
+struct AS_GlobalCtx as_ctx = { 0 };
+
+/// The number of calls to malloc, calloc and realloc so far.
+static size_t allocations = 0;
+/// Set once the first result has been printed.
+static bool printed = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+// The benchmark is linked with --wrap for each of these, so every
+// allocation made by the editor is counted
+void *__wrap_malloc(size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+
+	return __real_realloc(pointer, size);
+}
+
+/**
+ * A measurement in progress.
+ * */
+struct AS_Bench {
+	/// The name the result is reported under.
+	char *name;
+	/// The time spent so far, in nanoseconds.
+	double elapsed;
+	/// The number of allocations made so far.
+	size_t allocations;
+	/// The time the current run started.
+	struct timespec start;
+	/// The value of `allocations` when the current run started.
+	size_t start_allocations;
+};
+
+/**
+ * Start (or resume) timing a benchmark.
+ *
+ * @param struct AS_Bench *bench - The benchmark.
+ * */
+static void bench_start(struct AS_Bench *bench) {
+	bench->start_allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+	clock_gettime(CLOCK_MONOTONIC, &bench->start);
+}
+
+/**
+ * Stop timing a benchmark, the work done between here and the next
+ * bench_start is not counted.
+ *
+ * @param struct AS_Bench *bench - The benchmark.
+ * */
+static void bench_stop(struct AS_Bench *bench) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	bench->elapsed += (end.tv_sec - bench->start.tv_sec) * 1e9 + (end.tv_nsec - bench->start.tv_nsec);
+	bench->allocations += __atomic_load_n(&allocations, __ATOMIC_RELAXED) - bench->start_allocations;
+}
+
+/**
+ * Print the result of a benchmark as a JSON object.
+ *
+ * @param struct AS_Bench *bench - The benchmark, which has been stopped.
+ * @param long operations - The number of operations timed.
+ * */
+static void bench_report(struct AS_Bench *bench, long operations) {
+	operations = max(operations, 1L);
+
+	printf("%s\t\t{ \"name\": \"%s\", \"operations\": %ld, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f }",
+	       printed ? ",\n" : "", bench->name, operations, bench->elapsed / operations, (double)bench->allocations / operations);
+
+	printed = 1;
+}
+
+/**
+ * Write a file of synthetic assembly, a label, an instruction and a
+ * comment per line, separated by tabs.
+ *
+ * @param char *name - Template for mkstemps, ending in ".asm".
+ * @param int lines - The number of lines to write.
+ * */
+static void generate_source(char *name, int lines) {
+	int fd = mkstemps(name, strlen(".asm"));
+
+	if (fd == -1) {
+		printf("Failed to create %s\n", name);
+		exit(1);
+	}
+
+	FILE *file = fdopen(fd, "w");
+
+	for (int i = 0; i < lines; i++) {
+		fprintf(file, "label_%d:\tmov rax, [rbx + %d]\t; Line %d of the benchmark\n", i, i % 512, i);
+	}
+
+	fclose(file);
+}
+
+/**
+ * Write a configuration file of key bindings, column definitions and colors.
+ *
+ * @param char *name - Template for mkstemps, ending in ".cfg".
+ * @param int sets - The number of sets of commands to write.
+ * */
+static void generate_config(char *name, int sets) {
+	int fd = mkstemps(name, strlen(".cfg"));
+
+	if (fd == -1) {
+		printf("Failed to create %s\n", name);
+		exit(1);
+	}
+
+	FILE *file = fdopen(fd, "w");
+
+	for (int i = 0; i < sets; i++) {
+		fprintf(file, "# Set %d\n", i);
+		fprintf(file, "keyboard\tkeyseq up : 259, 0x%X\n", i);
+		fprintf(file, "columns\tdefine:[0, %d, %d]:'\t':%d\n", 8 + i % 32, 40 + i % 32, i % AS_MAX_COLUMNS);
+		fprintf(file, "themes\tforeground:%d:[%d, %d, %d]\n", i % 8, i % 1000, (i * 7) % 1000, (i * 13) % 1000);
+	}
+
+	fclose(file);
+}
+
+/**
+ * Place the cursor of the current file at a row, in every column.
+ *
+ * @param int row - The 0-based row.
+ * @param int x - The cursor's position in the active column.
+ * */
+static void place_cursor(int row, int x) {
+	struct AS_TextFile *file = as_ctx.text_file;
+
+	file->cy = row;
+
+	for (int i = 0; i < file->buffer_count; i++) {
+		file->buffers[i]->current_element = line_index_get(file, row, i);
+		file->buffers[i]->cx = 0;
+	}
+
+	file->active_buffer->cx = x;
+}
+
+/**
+ * Benchmark loading a file, every line of it.
+ *
+ * @param char *name - The file.
+ * @param int iterations - The number of times to load it.
+ * */
+static void bench_load(char *name, int iterations) {
+	struct AS_Bench bench = { .name = "load_file_content" };
+
+	for (int i = 0; i < iterations; i++) {
+		bench_start(&bench);
+		struct AS_TextFile *file = load_file(name);
+		load_file_lines(file, INT_MAX);
+		bench_stop(&bench);
+
+		destroy_file(file);
+		as_ctx.text_file = as_ctx.text_file_head = NULL;
+	}
+
+	bench_report(&bench, iterations);
+}
+
+/**
+ * Benchmark saving a file.
+ *
+ * Only the last line of the file is changed, then the whole file.
+ *
+ * @param int iterations - The number of times to save it.
+ * */
+static void bench_save(int iterations) {
+	struct AS_TextFile *file = as_ctx.text_file;
+	struct AS_Bench full = { .name = "save_file" };
+	struct AS_Bench tail = { .name = "save_file_last_line_modified" };
+
+	for (int i = 0; i < iterations; i++) {
+		// Start from the file as saved, so only the last line
+		// differs from it
+		reload_file(file);
+		load_file_lines(file, INT_MAX);
+		mark_file_modified(file, line_index_count(file) - 1);
+
+		bench_start(&tail);
+		save_file(file);
+		bench_stop(&tail);
+
+		mark_file_modified(file, 0);
+
+		bench_start(&full);
+		save_file(file);
+		bench_stop(&full);
+	}
+
+	bench_report(&full, iterations);
+	bench_report(&tail, iterations);
+}
+
+/**
+ * Benchmark typing characters onto the end of a line, then deleting them.
+ * */
+static void bench_chars() {
+	struct AS_Bench insert = { .name = "buffer_char_insert" };
+	struct AS_Bench del = { .name = "buffer_char_del" };
+
+	place_cursor(line_index_count(as_ctx.text_file) / 2, 0);
+
+	bench_start(&insert);
+
+	for (int i = 0; i < AS_BENCH_CHARS; i++) {
+		buffer_char_insert((i % 8 == 7) ? ' ' : 'a' + i % 26);
+	}
+
+	bench_stop(&insert);
+	bench_start(&del);
+
+	for (int i = 0; i < AS_BENCH_CHARS; i++) {
+		buffer_char_del();
+	}
+
+	bench_stop(&del);
+
+	bench_report(&insert, AS_BENCH_CHARS);
+	bench_report(&del, AS_BENCH_CHARS);
+}
+
+/**
+ * Benchmark splitting lines, then joining them back together.
+ * */
+static void bench_rows() {
+	struct AS_Bench split = { .name = "buffer_char_insert_newline" };
+	struct AS_Bench join = { .name = "buffer_char_del_newline" };
+
+	place_cursor(line_index_count(as_ctx.text_file) / 2, 1);
+
+	bench_start(&split);
+
+	for (int i = 0; i < AS_BENCH_ROWS; i++) {
+		as_ctx.text_file->active_buffer->cx = 1;
+		buffer_char_insert('\n');
+	}
+
+	bench_stop(&split);
+	bench_start(&join);
+
+	for (int i = 0; i < AS_BENCH_ROWS; i++) {
+		as_ctx.text_file->active_buffer->cx = 0;
+		buffer_char_del();
+	}
+
+	bench_stop(&join);
+
+	bench_report(&split, AS_BENCH_ROWS);
+	bench_report(&join, AS_BENCH_ROWS);
+}
+
+/**
+ * Benchmark pasting rows of text in one insertion, then undoing it.
+ * */
+static void bench_paste() {
+	struct AS_Bench paste = { .name = "buffer_insert_text" };
+	static const char row[] = "label:\tmov rax, 1\t; comment\n";
+
+	size_t length = (sizeof(row) - 1) * AS_BENCH_ROWS;
+	char *text = (char *)malloc(length);
+
+	for (int i = 0; i < AS_BENCH_ROWS; i++) {
+		memcpy(text + i * (sizeof(row) - 1), row, sizeof(row) - 1);
+	}
+
+	place_cursor(line_index_count(as_ctx.text_file) / 2, 0);
+
+	bench_start(&paste);
+	buffer_insert_text(text, length);
+	bench_stop(&paste);
+
+	// Put the file back as it was for the benchmarks after this one
+	undo(as_ctx.text_file);
+
+	bench_report(&paste, AS_BENCH_ROWS);
+
+	// Memory Manage
+	free(text);
+}
+
+/**
+ * Benchmark moving a line down the file, then back up.
+ * */
+static void bench_moves() {
+	struct AS_Bench down = { .name = "buffer_move_ln_down" };
+	struct AS_Bench up = { .name = "buffer_move_ln_up" };
+	int rows = min(AS_BENCH_ROWS, line_index_count(as_ctx.text_file) - 1);
+
+	place_cursor(0, 0);
+
+	bench_start(&down);
+
+	for (int i = 0; i < rows; i++) {
+		as_ctx.text_file->cy += buffer_move_ln_down(as_ctx.text_file->active_buffer);
+	}
+
+	bench_stop(&down);
+	bench_start(&up);
+
+	for (int i = 0; i < rows; i++) {
+		as_ctx.text_file->cy -= buffer_move_ln_up(as_ctx.text_file->active_buffer);
+	}
+
+	bench_stop(&up);
+
+	bench_report(&down, rows);
+	bench_report(&up, rows);
+}
+
+/**
+ * Benchmark highlighting every line of a file with the assembly backend.
+ * */
+static void bench_syntax() {
+	struct AS_Bench bench = { .name = "as_asm_get_syntax" };
+	struct AS_TextFile *file = as_ctx.text_file;
+	int (*get_syntax)(char *, int, struct AS_SyntaxPoint *) = file->syntax_backend->get_syntax;
+
+	int rows = line_index_count(file);
+	long operations = 0;
+	struct AS_SyntaxPoint *points = NULL;
+	int capacity = 0;
+
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < file->buffer_count; j++) {
+			struct AS_LLElement *element = line_index_get(file, i, j);
+
+			if (element->length == 0) {
+				continue;
+			}
+
+			if (element->length > capacity) {
+				capacity = element->length;
+				points = (struct AS_SyntaxPoint *)realloc(points, capacity * sizeof(struct AS_SyntaxPoint));
+			}
+
+			bench_start(&bench);
+			get_syntax(element->contents, element->length, points);
+			bench_stop(&bench);
+
+			operations++;
+		}
+	}
+
+	bench_report(&bench, operations);
+
+	// Memory Manage
+	free(points);
+}
+
+/**
+ * Benchmark lexing a configuration file.
+ *
+ * @param char *name - The configuration file.
+ * @param int iterations - The number of times to lex it.
+ * */
+static void bench_lex(char *name, int iterations) {
+	struct AS_Bench bench = { .name = "cfg_lex" };
+
+	for (int i = 0; i < iterations; i++) {
+		struct AS_Arena arena = { 0 };
+
+		bench_start(&bench);
+		cfg_lex(name, &arena);
+		bench_stop(&bench);
+
+		arena_destroy(&arena);
+	}
+
+	bench_report(&bench, iterations);
+}
+
+/**
+ * Benchmark rendering the editor screen into a headless terminal,
+ * for files from a thousand to a million lines.
+ *
+ * Every line of each file is loaded, so the time taken only stays the
+ * same across sizes if rendering stops once the screen is full. The
+ * status line changes every frame, so a row is drawn each time.
+ * */
+static void bench_render() {
+	static const int sizes[] = { 1000, 10000, 100000, 1000000 };
+
+	FILE *output = fopen("/dev/null", "w");
+	FILE *input = fopen("/dev/null", "r");
+
+	if (output == NULL || input == NULL || newterm("xterm", output, input) == NULL) {
+		printf("Failed to create a headless terminal\n");
+		exit(1);
+	}
+
+	for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		char name[64];
+		char source[] = "/tmp/assembled-bench-XXXXXX.asm";
+
+		generate_source(source, sizes[i]);
+		load_file_lines(load_file(source), INT_MAX);
+		switch_to_screen("editor");
+
+		sprintf(name, "render_%d_lines", sizes[i]);
+		struct AS_Bench bench = { .name = name };
+
+		for (int j = 0; j < AS_BENCH_FRAMES; j++) {
+			sprintf(as_ctx.editor_scr_message, "FRAME %d", j);
+			as_ctx.screen->update(&as_ctx.render_ctx);
+
+			bench_start(&bench);
+			as_ctx.screen->render(&as_ctx.render_ctx);
+			bench_stop(&bench);
+		}
+
+		bench_report(&bench, AS_BENCH_FRAMES);
+
+		destroy_all();
+		unlink(source);
+	}
+
+	endwin();
+
+	// Memory Manage
+	fclose(output);
+	fclose(input);
+}
+
+int main(int argc, char **argv) {
+	int lines = (argc > 1) ? atoi(argv[1]) : AS_BENCH_DEFAULT_LINES;
+	int iterations = (argc > 2) ? atoi(argv[2]) : AS_BENCH_DEFAULT_ITERATIONS;
+
+	lines = max(lines, 1);
+	iterations = max(iterations, 1);
+
+	// Three columns, as an assembly layout would have
+	static int column_positions[] = { 0, 32, 64 };
+
+	as_ctx.col_desc_i = 0;
+	as_ctx.col_descs[0].column_positions = column_positions;
+	as_ctx.col_descs[0].column_count = 3;
+	as_ctx.col_descs[0].delimiter = '\t';
+	as_ctx.undo_limit = AS_UNDO_DEFAULT_LIMIT;
+	as_ctx.render_ctx.max_x = 80;
+	as_ctx.render_ctx.max_y = 24;
+
+	init_syntax();
+
+	// Editing goes through the editor screen, without a terminal
+	register_editor_screen();
+	switch_to_screen("editor");
+
+	char source[] = "/tmp/assembled-bench-XXXXXX.asm";
+	char config[] = "/tmp/assembled-bench-XXXXXX.cfg";
+
+	generate_source(source, lines);
+	generate_config(config, max(lines / 100, 1));
+
+	printf("{\n\t\"lines\": %d,\n\t\"iterations\": %d,\n\t\"processors\": %d,\n\t\"benchmarks\": [\n", lines, iterations, parallel_workers());
+
+	bench_load(source, iterations);
+
+	// The rest work on a fully loaded file
+	load_file_lines(load_file(source), INT_MAX);
+
+	bench_syntax();
+	bench_chars();
+	bench_rows();
+	bench_paste();
+	bench_moves();
+	bench_save(iterations);
+	bench_lex(config, iterations);
+
+	// Renders files of its own
+	destroy_all();
+	bench_render();
+
+	printf("\n\t]\n}\n");
+
+	stop_syntax();
+
+	unlink(source);
+	unlink(config);
+
+	return 0;
+}
@@ -31,6 +31,7 @@
 
 #include <editor/buffer/editor.h>
 #include <editor/buffer/buffer.h>
+#include <editor/syntax/syntax.h>
 
 #include <interface/interface.h>
 
@@ -38,17 +39,117 @@
 #include <includes.h>
 #include <string.h>
 
-/**
- * Function to free a `struct AS_LLElement`
- *
- * @param element - Pointer to the element to be freed
- * @return void
- * */
+/// The smallest allocation given to a line's contents.
+#define LINE_MIN_CAPACITY 16
+
+struct AS_LLElement *new_line_list_element(const char *text, size_t length) {
+	struct AS_LLElement *element = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
+	memset(element, 0, sizeof(struct AS_LLElement));
+
+	line_insert(element, 0, text, length);
+	element->dirty = 1;
+
+	return element;
+}
+
 void free_line_list_element(struct AS_LLElement *element) {
-	free(element->contents);
+	// The line's syntax belongs to its file's syntax arena
+
+	if (element->capacity > 0) {
+		// Views into a file's original contents are not owned
+		free(element->contents);
+	}
+
+	if (element->syntax_jobs > 0) {
+		// The syntax worker still has jobs for this line, the
+		// last of their results frees it
+		element->contents = NULL;
+		element->capacity = 0;
+		element->orphaned = 1;
+
+		return;
+	}
+
 	free(element);
 }
 
+void line_reserve(struct AS_LLElement *element, size_t length) {
+	if (length + 1 <= element->capacity) {
+		// Already large enough
+		return;
+	}
+
+	// Double the allocation until it fits
+	size_t capacity = max(element->capacity * 2, LINE_MIN_CAPACITY);
+
+	while (capacity < length + 1) {
+		capacity *= 2;
+	}
+
+	if (element->capacity == 0) {
+		// The line is empty or a view into its file's original
+		// contents, copy it into its own allocation
+		char *contents = (char *)malloc(capacity);
+
+		if (element->length > 0) {
+			memcpy(contents, element->contents, element->length);
+		}
+
+		contents[element->length] = 0;
+		element->contents = contents;
+	} else {
+		element->contents = (char *)realloc(element->contents, capacity);
+	}
+
+	element->capacity = capacity;
+}
+
+void line_insert(struct AS_LLElement *element, size_t x, const char *text, size_t length) {
+	if (length == 0) {
+		return;
+	}
+
+	line_reserve(element, element->length + length);
+
+	x = min(x, element->length);
+
+	// Shift everything after x over (including the zero terminator)
+	// and place the text in the gap
+	memmove(element->contents + x + length, element->contents + x, element->length - x + 1);
+	memcpy(element->contents + x, text, length);
+
+	element->length += length;
+	element->dirty = 1;
+	element->version++;
+}
+
+void line_erase(struct AS_LLElement *element, size_t x, size_t length) {
+	if (x >= element->length) {
+		return;
+	}
+
+	length = min(length, element->length - x);
+
+	if (element->capacity == 0 && (x == 0 || x + length == element->length)) {
+		// Cutting either end off of a view does not need a copy
+		element->contents += (x == 0) ? length : 0;
+		element->length -= length;
+		element->dirty = 1;
+		element->version++;
+
+		return;
+	}
+
+	line_reserve(element, element->length);
+
+	// Shift everything after the erased region back (including the zero terminator)
+	memmove(element->contents + x, element->contents + x + length, element->length - x - length + 1);
+
+	element->length -= length;
+	element->dirty = 1;
+	element->version++;
+}
+
 struct AS_TextBuf *new_buffer(int col_start, int col_end) {
 	// Allocate buffer
 	struct AS_TextBuf *buffer = (struct AS_TextBuf *)malloc(sizeof(struct AS_TextBuf));
@@ -60,9 +161,8 @@ struct AS_TextBuf *new_buffer(int col_start, int col_end) {
 	buffer->col_end = col_end;
 
 	// Give it a starting line list element
-	buffer->head = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
+	buffer->head = new_line_list_element(NULL, 0);
 	buffer->virtual_head = buffer->head;
-	memset(buffer->head, 0, sizeof(struct AS_LLElement));
 
 	return buffer;
 }
@@ -74,9 +174,7 @@ void destroy_buffer(struct AS_TextBuf *buffer) {
 
 	while (current != NULL) {
 		struct AS_LLElement *temp = current->next;
-		free(current->contents);
-
-		free(current);
+		free_line_list_element(current);
 
 		current = temp;
 	}
@@ -85,21 +183,56 @@ void destroy_buffer(struct AS_TextBuf *buffer) {
 	free(buffer);
 }
 
+/**
+ * Find the column of a buffer in the current file.
+ *
+ * @param struct AS_TextBuf *buffer - The buffer.
+ * @return The 0-based column, 0 if the buffer is not in the file.
+ * */
+static int buffer_column(struct AS_TextBuf *buffer) {
+	for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
+		if (as_ctx.text_file->buffers[i] == buffer) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
 // Buffer is the current active buffer
 
 // Insert character c into the current active buffer
-
-// ERROR: New lines sometimes result in leaks 
-//	  (random characters on a string due
-//	   a lack of a zero terminator)
 void buffer_char_insert(char c) {
 	// Get the element at which we need to insert the buffer
 	struct AS_TextBuf *active_text_buffer = as_ctx.text_file->active_buffer;
 	struct AS_LLElement *element = active_text_buffer->current_element;
 
+	// The cursor may have been moved past the end of the line
+	// since the last render restricted it
+	active_text_buffer->cx = min(active_text_buffer->cx, (int)element->length);
+
+	mark_file_modified(as_ctx.text_file, as_ctx.text_file->cy);
+
+	int column = buffer_column(active_text_buffer);
+
 	// Check for special cases
 	switch (c) {
 	case '\n': {
+		// Journal the split, the other buffers are split at
+		// the start or the end of their lines
+		int *xs = (int *)malloc(as_ctx.text_file->buffer_count * sizeof(int));
+
+		for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
+			xs[i] = active_text_buffer->cx;
+
+			if (as_ctx.text_file->buffers[i] != active_text_buffer) {
+				xs[i] = (active_text_buffer->cx > 0) ? (int)as_ctx.text_file->buffers[i]->current_element->length : 0;
+			}
+		}
+
+		undo_record_split(as_ctx.text_file, as_ctx.text_file->cy, column, xs);
+		free(xs);
+
 		// Iterate through all buffers excluding the active one
 		for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
 			if (as_ctx.text_file->buffers[i] == active_text_buffer) {
@@ -108,13 +241,8 @@ void buffer_char_insert(char c) {
 
 			// Create a new line and its element
 			struct AS_LLElement *tmp = as_ctx.text_file->buffers[i]->current_element;
-			struct AS_LLElement *new_element = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
-			memset(new_element, 0, sizeof(struct AS_LLElement));
+			struct AS_LLElement *new_element = new_line_list_element(NULL, 0);
 
-			// Allocate contents
-			new_element->contents = (char *)malloc(1);
-			*(new_element->contents) = 0;
-			
 			// Check if the new line will be at the beginning 
 			// of a line
 			if (active_text_buffer->cx > 0) {
@@ -152,13 +280,14 @@ void buffer_char_insert(char c) {
 				// If current_element was the virtual head of the file
 				// update it to be new_element
 				if (tmp == as_ctx.text_file->buffers[i]->virtual_head) {
-					as_ctx.text_file_head->buffers[i]->virtual_head = new_element;
+					as_ctx.text_file->buffers[i]->virtual_head = new_element;
 				}
 			}
 		}
-		// Create new element
-		struct AS_LLElement *next_element = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
-		memset(next_element, 0, sizeof(struct AS_LLElement));
+		// Create new element, moving everything after the cursor
+		// onto it
+		struct AS_LLElement *next_element = new_line_list_element(element->contents + active_text_buffer->cx,
+									  element->length - active_text_buffer->cx);
 
 		// Insert it into list
 		next_element->next = element->next;
@@ -170,29 +299,9 @@ void buffer_char_insert(char c) {
 
 		element->next = next_element;
 
-		// See if user pressed enter within the line
-		size_t new_line_size = strlen(element->contents) - active_text_buffer->cx;
-
-		// Allocate new contents
-		int contents_length = max(new_line_size, 1);
-		char *contents = (char *)malloc(contents_length);
-		memset(contents, 0, contents_length);
-
-		// If the user pressed enter within the line then
-		if (new_line_size > 0) {
-			// Copy everything after the cursor to the new line
-			strcpy(contents, element->contents + active_text_buffer->cx);
-
-			// Calculate the number of characters left in this line
-			size_t post_copy_size = strlen(element->contents) - new_line_size;
-			// Adjust allocation
-			element->contents = (char *)realloc(element->contents, post_copy_size + 1);
-			// Null terminate
-			*(element->contents + post_copy_size) = 0;
-		}
+		// Cut the moved characters off of this line
+		line_erase(element, active_text_buffer->cx, element->length - active_text_buffer->cx);
 
-		// Set contents
-		next_element->contents = contents;
 		// Manage
 		active_text_buffer->current_element = next_element;
 
@@ -200,26 +309,17 @@ void buffer_char_insert(char c) {
 		(as_ctx.text_file->cy)++;
 		(active_text_buffer->cx) = 0;
 
+		line_index_insert(as_ctx.text_file, as_ctx.text_file->cy);
+
 		as_ctx.screen->local(LOCAL_LINE_INSERT, 0);
 
 		break;
 	}
 
 	default: {
-		// Default, create new string
-		char *new_string = (char *)malloc(strlen(element->contents) + 2); // New character and NULL terminaator
-		memset(new_string, 0, strlen(element->contents) + 2);
-
-		// Copy 0 -> cx
-		strncpy(new_string, element->contents, active_text_buffer->cx);
-		// Set space after first portion to new character
-		new_string[active_text_buffer->cx] = c;
-		// Concatenate the last bit of the string
-		strcat(new_string, element->contents + active_text_buffer->cx);
-
-		// Memory Manage, replace string
-		free(element->contents);
-		element->contents = new_string;
+		// Default, insert the character at the cursor
+		undo_record_insert(as_ctx.text_file, as_ctx.text_file->cy, column, active_text_buffer->cx, &c, 1);
+		line_insert(element, active_text_buffer->cx, &c, 1);
 
 		// Move cursor
 		(active_text_buffer->cx)++;
@@ -229,6 +329,181 @@ void buffer_char_insert(char c) {
 	}
 }
 
+/**
+ * Link a line into a column after another line.
+ *
+ * The line takes over as the column's head or virtual head if it is
+ * linked in before them.
+ *
+ * @param struct AS_TextBuf *buffer - The buffer of the column.
+ * @param struct AS_LLElement *prev - The line to link it after, NULL to link it in as the first line.
+ * @param struct AS_LLElement *element - The line to link in.
+ * */
+static void link_line(struct AS_TextBuf *buffer, struct AS_LLElement *prev, struct AS_LLElement *element) {
+	struct AS_LLElement *next = (prev != NULL) ? prev->next : buffer->head;
+
+	element->prev = prev;
+	element->next = next;
+
+	if (next != NULL) {
+		next->prev = element;
+	}
+
+	if (prev != NULL) {
+		prev->next = element;
+	} else {
+		buffer->head = element;
+	}
+
+	if (next != NULL && next == buffer->virtual_head) {
+		buffer->virtual_head = element;
+	}
+}
+
+int buffer_insert_text(const char *text, size_t length) {
+	struct AS_TextFile *file = as_ctx.text_file;
+	struct AS_TextBuf *active_text_buffer = file->active_buffer;
+	int delimiter = as_ctx.col_descs[as_ctx.col_desc_i].delimiter;
+	int column = buffer_column(active_text_buffer);
+	int count = file->buffer_count;
+	int row = file->cy;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	// The cursor may have been moved past the end of the line
+	// since the last render restricted it
+	active_text_buffer->cx = min(active_text_buffer->cx, (int)active_text_buffer->current_element->length);
+
+	mark_file_modified(file, row);
+
+	// The line of every column on the row being filled in, and the
+	// lines of the cursor's row which end up after the inserted text
+	struct AS_LLElement **lines = (struct AS_LLElement **)malloc(count * sizeof(struct AS_LLElement *));
+	struct AS_LLElement **after = (struct AS_LLElement **)malloc(count * sizeof(struct AS_LLElement *));
+	int *xs = (int *)malloc(count * sizeof(int));
+
+	for (int i = 0; i < count; i++) {
+		lines[i] = file->buffers[i]->current_element;
+		after[i] = lines[i];
+	}
+
+	struct AS_LLElement *tail = NULL;
+	int x = active_text_buffer->cx;
+	int rows = 0;
+
+	// The whole text is undone in one step
+	undo_begin(file);
+
+	const char *line = text;
+	const char *end = text + length;
+
+	while (1) {
+		const char *line_end = memchr(line, '\n', end - line);
+		bool last = (line_end == NULL);
+
+		if (last) {
+			line_end = end;
+		}
+
+		if (rows == 0 && !last) {
+			// The text after the cursor moves down with the rest
+			// of the row, whose lines in the columns after the
+			// cursor's are replaced on this row
+			struct AS_LLElement *element = lines[column];
+
+			tail = new_line_list_element(element->contents + x, element->length - x);
+			line_erase(element, x, element->length - x);
+
+			for (int i = column + 1; i < count; i++) {
+				lines[i] = new_line_list_element(NULL, 0);
+				link_line(file->buffers[i], after[i]->prev, lines[i]);
+			}
+		}
+
+		if (rows > 0) {
+			// Start the next row, the last one is made of the
+			// lines left after the cursor
+			for (int i = 0; i < count; i++) {
+				struct AS_LLElement *element = NULL;
+
+				if (last && i == column) {
+					element = tail;
+				} else if (last && i > column) {
+					element = after[i];
+				} else {
+					element = new_line_list_element(NULL, 0);
+				}
+
+				if (element != after[i]) {
+					link_line(file->buffers[i], (i <= column) ? lines[i] : after[i]->prev, element);
+				}
+
+				lines[i] = element;
+			}
+		}
+
+		for (int i = 0; i < count; i++) {
+			xs[i] = (i < column) ? (int)lines[i]->length : 0;
+		}
+
+		// Split the line into cells from the cursor's column on,
+		// the last column takes the rest of the line
+		const char *cell = line;
+
+		for (int i = column; i < count; i++) {
+			const char *cell_end = (i < count - 1) ? memchr(cell, delimiter, line_end - cell) : NULL;
+			cell_end = (cell_end != NULL) ? cell_end : line_end;
+
+			int cell_x = (i == column && rows == 0) ? x : 0;
+			size_t cell_length = cell_end - cell;
+
+			if (cell_length > 0) {
+				undo_record_insert(file, row + rows, i, cell_x, cell, cell_length);
+				line_insert(lines[i], cell_x, cell, cell_length);
+			}
+
+			xs[i] = cell_x + cell_length;
+
+			if (i == column) {
+				active_text_buffer->cx = xs[i];
+			}
+
+			if (cell_end == line_end) {
+				break;
+			}
+
+			cell = cell_end + 1;
+		}
+
+		if (last) {
+			break;
+		}
+
+		undo_record_split(file, row + rows, column, xs);
+
+		line = line_end + 1;
+		rows++;
+	}
+
+	undo_end(file);
+
+	for (int i = 0; i < count; i++) {
+		file->buffers[i]->current_element = lines[i];
+	}
+
+	file->cy = row + rows;
+	line_index_insert_rows(file, row + 1, rows);
+
+	// Memory Manage
+	free(lines);
+	free(after);
+	free(xs);
+
+	return rows;
+}
+
 void buffer_char_del() {
 	// Get the element at which we need to insert the buffer
 	struct AS_TextBuf *active_text_buffer = as_ctx.text_file->active_buffer;
@@ -240,8 +515,22 @@ void buffer_char_del() {
 
 	struct AS_LLElement *element = active_text_buffer->current_element;
 
+	// The cursor may have been moved past the end of the line
+	// since the last render restricted it
+	active_text_buffer->cx = min(active_text_buffer->cx, (int)element->length);
+
 	// Remove a line
 	if (active_text_buffer->cx <= 0) {
+		// Journal the join, along with where each line ended
+		int *xs = (int *)malloc(as_ctx.text_file->buffer_count * sizeof(int));
+
+		for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
+			xs[i] = as_ctx.text_file->buffers[i]->current_element->prev->length;
+		}
+
+		undo_record_join(as_ctx.text_file, as_ctx.text_file->cy - 1, buffer_column(active_text_buffer), xs);
+		free(xs);
+
 		// Iterate through all buffers
 		for (int i = 0; i < as_ctx.col_descs[as_ctx.col_desc_i].column_count; i++) {
 			// Get the current element
@@ -255,15 +544,19 @@ void buffer_char_del() {
 			int cx = -1;
 
 			// If the line has characters on it, add them to the previous line
-			if (strlen(element->next->contents) > 0) {
-				cx = strlen(element->contents);
+			if (element->next->length > 0) {
+				cx = element->length;
+
+				line_insert(element, element->length, element->next->contents, element->next->length);
+			}
 
-				size_t size = cx + strlen(element->next->contents) + 1;
-				element->contents = (char *)realloc(element->contents, size);
-				strcat(element->contents, element->next->contents);
+			// The screen may have started on the removed line
+			if (element->next == as_ctx.text_file->buffers[i]->virtual_head) {
+				as_ctx.text_file->buffers[i]->virtual_head = element;
 			}
 
 			// Memory Manage
+			as_ctx.text_file->syntax_waste += element->next->syntax_capacity * sizeof(struct AS_SyntaxPoint);
 			free_line_list_element(element->next);
 			
 			// Update links
@@ -274,7 +567,7 @@ void buffer_char_del() {
 			}
 
 			// Update cursor
-			(as_ctx.text_file->buffers[i]->cx) = cx == -1 ? strlen(element->contents) : cx - 1;
+			(as_ctx.text_file->buffers[i]->cx) = cx == -1 ? element->length : cx - 1;
 
 			if (as_ctx.text_file->buffers[i]->cx < 0) {
 				as_ctx.text_file->buffers[i]->cx = 0;
@@ -284,6 +577,9 @@ void buffer_char_del() {
 			as_ctx.text_file->buffers[i]->current_element = element;
 		}
 
+		line_index_erase(as_ctx.text_file, as_ctx.text_file->cy);
+		mark_file_modified(as_ctx.text_file, as_ctx.text_file->cy - 1);
+
 		(as_ctx.text_file->cy)--;
 
 		as_ctx.screen->local(LOCAL_LINE_DELETION, 0);
@@ -292,16 +588,10 @@ void buffer_char_del() {
 	}
 
 	// Remove a character
-	// Allocate a new string
-	char *new_string = strdup(element->contents);
-	// Copy latter half over the first -1 character
-	strncpy(new_string + active_text_buffer->cx - 1, element->contents + active_text_buffer->cx, strlen(element->contents) - active_text_buffer->cx);
-	new_string[strlen(new_string) - 1] = 0;
-
-	// Memory Manage
-	free(element->contents);
-
-	element->contents = new_string;
+	undo_record_delete(as_ctx.text_file, as_ctx.text_file->cy, buffer_column(active_text_buffer), active_text_buffer->cx - 1,
+			   element->contents + active_text_buffer->cx - 1, 1);
+	line_erase(element, active_text_buffer->cx - 1, 1);
+	mark_file_modified(as_ctx.text_file, as_ctx.text_file->cy);
 
 	(active_text_buffer->cx)--;
 }
@@ -317,6 +607,15 @@ int buffer_move_ln_up(struct AS_TextBuf *active_buffer) {
 	struct AS_LLElement *next = current->next;
 	struct AS_LLElement *prev = current->prev;
 
+	// The rows which will change
+	int first = as_ctx.text_file->cy;
+	int last = as_ctx.text_file->cy;
+
+	if (active_buffer->selection_enabled) {
+		first = min(first, active_buffer->selection_start.y);
+		last = max(last, active_buffer->selection_start.y);
+	}
+
 	if (active_buffer->selection_enabled && as_ctx.text_file->cy != active_buffer->selection_start.y) {
 		// There is a selection, move selection
 		// Get the head of the selection
@@ -359,6 +658,10 @@ int buffer_move_ln_up(struct AS_TextBuf *active_buffer) {
 			next->prev = prev;
 		}
 
+		line_index_refresh(as_ctx.text_file, first - 1, last);
+		mark_file_modified(as_ctx.text_file, first - 1);
+		undo_record_move(as_ctx.text_file, buffer_column(active_buffer), first, last, 1);
+
 		return 1;
 	}
 
@@ -391,6 +694,10 @@ int buffer_move_ln_up(struct AS_TextBuf *active_buffer) {
 	prev->next = next;
 	prev->prev = current;
 
+	line_index_refresh(as_ctx.text_file, first - 1, last);
+	mark_file_modified(as_ctx.text_file, first - 1);
+	undo_record_move(as_ctx.text_file, buffer_column(active_buffer), first, last, 1);
+
 	return 1;
 }
 
@@ -404,6 +711,15 @@ int buffer_move_ln_down(struct AS_TextBuf *active_buffer) {
 	struct AS_LLElement *next = current->next;
 	struct AS_LLElement *prev = current->prev;
 
+	// The rows which will change
+	int first = as_ctx.text_file->cy;
+	int last = as_ctx.text_file->cy;
+
+	if (active_buffer->selection_enabled) {
+		first = min(first, active_buffer->selection_start.y);
+		last = max(last, active_buffer->selection_start.y);
+	}
+
 	if (active_buffer->selection_enabled && as_ctx.text_file->cy != active_buffer->selection_start.y) {
 		// There is a selection, move selection
 		struct AS_LLElement *head = active_buffer->selection_start_line;
@@ -445,6 +761,10 @@ int buffer_move_ln_down(struct AS_TextBuf *active_buffer) {
 		next->prev = prev;
 		head->prev = next;
 
+		line_index_refresh(as_ctx.text_file, first, last + 1);
+		mark_file_modified(as_ctx.text_file, first);
+		undo_record_move(as_ctx.text_file, buffer_column(active_buffer), first, last, 0);
+
 		return 1;
 	}
 
@@ -475,5 +795,9 @@ int buffer_move_ln_down(struct AS_TextBuf *active_buffer) {
 	next->prev = current->prev;
 	current->prev = next;
 
+	line_index_refresh(as_ctx.text_file, first, last + 1);
+	mark_file_modified(as_ctx.text_file, first);
+	undo_record_move(as_ctx.text_file, buffer_column(active_buffer), first, last, 0);
+
 	return 1;
 }
@@ -28,140 +28,639 @@
  * Handles files.
 */
 
+// For mremap
+#define _GNU_SOURCE
+
 #include <editor/buffer/buffer.h>
+#include <editor/buffer/scan.h>
+#include <editor/syntax/syntax.h>
 #include <editor/config.h>
 #include <editor/buffer/editor.h>
 
 #include <global.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <includes.h>
 
+/// The number of bytes of a file parsed into lines at a time.
+#define AS_LOAD_CHUNK_SIZE (4 * 1024 * 1024)
+/// The number of lines past the cursor loaded when a file is opened.
+#define AS_LOAD_MARGIN_LINES 256
+/// The length of a line in bytes assumed before any lines of a file are loaded.
+#define AS_LOAD_LINE_GUESS 64
+
+/// The number of spans gathered before they are written (at most IOV_MAX).
+#define AS_SAVE_IOV_COUNT 1024
+
 /**
- * Load the content of a file in the format of struct AS_TextBuf.
+ * Gathers the spans of a file being saved into as few writes as possible.
+ * */
+struct AS_SaveWriter {
+	/// The descriptor being written to.
+	int fd;
+	/// The number of spans in `iov`.
+	int count;
+	/// The spans waiting to be written.
+	struct iovec iov[AS_SAVE_IOV_COUNT];
+};
+
+/**
+ * A file mapped as the original contents of a text file.
  *
- * @param struct AS_TextFile *text_file - The text file who's content needs to be loaded
+ * Another process truncating the file makes touching its pages past the
+ * new end of the file raise SIGBUS. The handler looks the faulting
+ * address up among these, so they are only ever added to, and entries
+ * are reused once free.
  * */
-void load_file_content(struct AS_TextFile *text_file) {
-	FILE *file = text_file->file;
-	struct AS_ColDesc descriptor = as_ctx.col_descs[as_ctx.col_desc_i];
-        int column_count = descriptor.column_count;
+struct AS_FileMapping {
+	/// Set (1) while the entry belongs to a mapping.
+	int claimed;
+	/// The start of the mapping, NULL while the entry is not in use.
+	char *start;
+	/// The size of the mapping in bytes.
+	size_t size;
+	/// Set (1) once pages of the mapping were lost to the file being truncated.
+	volatile sig_atomic_t truncated;
+	/// The next entry, NULL if this is the last.
+	struct AS_FileMapping *next;
+};
+
+/// Every file mapping there has been, newest first.
+static struct AS_FileMapping *file_mappings = NULL;
+/// The size of a page.
+static size_t page_size = 0;
+/// The action SIGBUS had before truncation_handler.
+static struct sigaction previous_sigbus;
+/// Installs truncation_handler once.
+static pthread_once_t truncation_handler_once = PTHREAD_ONCE_INIT;
 
-	text_file->buffer_count = column_count;
+/**
+ * Handle a SIGBUS raised by touching the pages of a mapped file past its end.
+ *
+ * The pages from the faulting one to the end of the mapping are replaced
+ * with zeroed ones, so the lost part of the file reads as NUL characters
+ * rather than taking down the editor. Faults anywhere else are given to
+ * the previous action.
+ * */
+static void truncation_handler(int signal, siginfo_t *info, void *context) {
+	char *address = (char *)info->si_addr;
 
-        // Allocate text buffers (columns)
-        text_file->buffers = (struct AS_TextBuf **)calloc(column_count, sizeof(struct AS_TextBuf *));
-        struct AS_LLElement **currents = (struct AS_LLElement **)calloc(column_count, sizeof(struct AS_LLElement *));
+	for (struct AS_FileMapping *mapping = __atomic_load_n(&file_mappings, __ATOMIC_ACQUIRE); mapping != NULL;
+	     mapping = mapping->next) {
+		char *start = __atomic_load_n(&mapping->start, __ATOMIC_ACQUIRE);
 
-        for (int i = 0; i < column_count; i++) {
-                struct AS_TextBuf *buffer = new_buffer(descriptor.column_positions[i], (i + 1 >= column_count) ? -1 :
-						       descriptor.column_positions[i + 1]);
+		if (start == NULL || address < start || address >= start + mapping->size) {
+			continue;
+		}
 
-                text_file->buffers[i] = buffer;
-                currents[i] = buffer->head;
-                buffer->current_element = currents[i];
-        }
+		char *page = start + (size_t)(address - start) / page_size * page_size;
+		size_t length = start + mapping->size - page;
 
-        // Read file
-        char *contents;
-        size_t size = 0;
-        int line_count = 0;
+		if (mmap(page, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+			mapping->truncated = 1;
 
-        while (getline(&contents, &size, file) != -1) {
-		if (size < 0) {
-			break;
+			return;
 		}
 
-                if (contents[strlen(contents) - 1] == '\n') {
-                        contents[strlen(contents) - 1] = 0;
-                }
+		break;
+	}
 
-                int element = 0;
-                int prev_i = 0;
+	// Not a truncated file, the fault happens again under the previous action
+	sigaction(SIGBUS, &previous_sigbus, NULL);
+}
 
-                for (int i = 0; i < strlen(contents) + 1; i++) {
-			if (element == column_count - 1) {
-				i = strlen(contents) + 1;
-				goto read_column;
-			}
+/**
+ * Install truncation_handler, called once.
+ * */
+static void install_truncation_handler() {
+	page_size = sysconf(_SC_PAGESIZE);
 
-                        if (contents[i] != descriptor.delimiter && i != strlen(contents)) {
-                                continue;
-                        }
+	struct sigaction action = { 0 };
+	action.sa_sigaction = truncation_handler;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
 
-			read_column:;
+	sigaction(SIGBUS, &action, &previous_sigbus);
+}
 
-                        int element_index = min(element, column_count - 1);
+/**
+ * Register a mapped file with truncation_handler.
+ *
+ * @param char *start - The start of the mapping.
+ * @param size_t size - The size of the mapping in bytes.
+ * @return The entry of the mapping.
+ * */
+static struct AS_FileMapping *register_mapping(char *start, size_t size) {
+	struct AS_FileMapping *mapping = __atomic_load_n(&file_mappings, __ATOMIC_ACQUIRE);
 
-                        // Allocate contents
-                        currents[element_index]->contents = (char *)malloc(i - prev_i + 1);
-                        memset(currents[element_index]->contents, 0, i - prev_i + 1);
+	// Reuse a free entry, files are mapped from several workers at once
+	while (mapping != NULL && __atomic_exchange_n(&mapping->claimed, 1, __ATOMIC_ACQ_REL) != 0) {
+		mapping = mapping->next;
+	}
 
-                        // Copy line
-                        strncpy(currents[element_index]->contents, contents + prev_i, (i - prev_i));
+	if (mapping == NULL) {
+		mapping = (struct AS_FileMapping *)calloc(1, sizeof(struct AS_FileMapping));
+		mapping->claimed = 1;
+		mapping->next = __atomic_load_n(&file_mappings, __ATOMIC_ACQUIRE);
 
-                        // Allocate new line
-                        currents[element_index]->next = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
-                        memset(currents[element_index]->next, 0, sizeof(struct AS_LLElement));
+		while (!__atomic_compare_exchange_n(&file_mappings, &mapping->next, mapping, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	}
 
-                        // Advance
-                        currents[element_index]->next->prev = currents[element_index];
-                        currents[element_index] = currents[element_index]->next;
+	// The size has to be in place before the handler can see the start
+	mapping->size = size;
+	mapping->truncated = 0;
+	__atomic_store_n(&mapping->start, start, __ATOMIC_RELEASE);
 
-                        // Move onto next region of text
-                        prev_i = i + 1;
+	return mapping;
+}
 
-                        // Advance to next column / buffer
-                        element++;
-                }
+/**
+ * Free the entry of a mapped file, before it is unmapped.
+ *
+ * @param struct AS_FileMapping *mapping - The entry.
+ * */
+static void unregister_mapping(struct AS_FileMapping *mapping) {
+	__atomic_store_n(&mapping->start, NULL, __ATOMIC_RELEASE);
+	__atomic_store_n(&mapping->claimed, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Map the original contents of a file into memory.
+ *
+ * The file is mapped read-only, so loading it costs no copies and its pages
+ * are only read in as they are touched. Pages lost to another process
+ * truncating the file read as zeros (see truncation_handler). If the file
+ * cannot be mapped, it is read into an anonymous mapping instead.
+ *
+ * @param struct AS_TextFile *text_file - The text file who's original contents need to be mapped.
+ * */
+static void map_original(struct AS_TextFile *text_file) {
+	text_file->original = NULL;
+	text_file->original_size = 0;
+	text_file->mapping = NULL;
 
-                // Fill up rest of the columns
-                for (int i = element; i < column_count; i++) {
-                        // Allocate contents
-                        currents[i]->contents = (char *)malloc(1);
-                        *currents[i]->contents = 0;
+	pthread_once(&truncation_handler_once, install_truncation_handler);
 
-                        // Allocate new line
-                        currents[i]->next = (struct AS_LLElement *)malloc(sizeof(struct AS_LLElement));
-                        memset(currents[i]->next, 0, sizeof(struct AS_LLElement));
+	int fd = open(text_file->name, O_RDONLY);
 
-                        currents[i]->next->prev = currents[i];
-                        currents[i] = currents[i]->next;
-                }
+	if (fd == -1) {
+		AS_DEBUG_MSG("Failed to open %s for mapping\n", text_file->name);
+
+		return;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+		// Nothing to map
+		close(fd);
+
+		return;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (map != MAP_FAILED) {
+		text_file->mapping = register_mapping((char *)map, st.st_size);
+	} else {
+		AS_DEBUG_MSG("Failed to map %s, reading it instead\n", text_file->name);
+
+		map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (map == MAP_FAILED) {
+			close(fd);
+
+			return;
+		}
+
+		size_t size = 0;
+		ssize_t r = 0;
+
+		while (size < st.st_size && (r = read(fd, (char *)map + size, st.st_size - size)) > 0) {
+			size += r;
+		}
+
+		mprotect(map, st.st_size, PROT_READ);
+	}
+
+	text_file->original = (char *)map;
+	text_file->original_size = st.st_size;
+
+	// The mapping stays valid once the descriptor is closed
+	close(fd);
+}
+
+/**
+ * Copy the original contents of a file out of the file it is mapped
+ * from, in place, so that the file can be written over.
+ *
+ * @param struct AS_TextFile *text_file - The text file.
+ * @return 0 on success, -1 if the contents could not be copied.
+ * */
+static int detach_original(struct AS_TextFile *text_file) {
+	if (text_file->mapping == NULL) {
+		// Already in memory of its own
+		return 0;
+	}
+
+	size_t size = text_file->original_size;
+	void *copy = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (copy == MAP_FAILED) {
+		return -1;
+	}
+
+	memcpy(copy, text_file->original, size);
+	mprotect(copy, size, PROT_READ);
+
+	// Lines are views into the contents, so the copy takes the place of the mapping
+	unregister_mapping(text_file->mapping);
+	text_file->mapping = NULL;
+
+	if (mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, text_file->original) == MAP_FAILED) {
+		AS_DEBUG_MSG("Failed to move the copy of %s into place\n", text_file->name);
+		text_file->mapping = register_mapping(text_file->original, size);
+		munmap(copy, size);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Unmap the original contents of a file.
+ *
+ * @param struct AS_TextFile *text_file - The text file who's original contents need to be unmapped.
+ * */
+static void unmap_original(struct AS_TextFile *text_file) {
+	if (text_file->mapping != NULL) {
+		unregister_mapping(text_file->mapping);
+	}
+
+	if (text_file->original != NULL) {
+		munmap(text_file->original, text_file->original_size);
+	}
+
+	text_file->original = NULL;
+	text_file->original_size = 0;
+	text_file->mapping = NULL;
+}
+
+/**
+ * A range of a file's original contents which is parsed into lines on its own.
+ *
+ * The ranges of a file are parsed in parallel, their lines are then
+ * linked onto the ends of the file's columns in order.
+ * */
+struct AS_ParseSegment {
+	/// The file being loaded.
+	struct AS_TextFile *file;
+	/// The offset of the first character of the range, always the start of a line.
+	size_t start;
+	/// The offset just past the range, just past a newline or the end of the file.
+	size_t end;
+	/// Set if the range starts the file, the first line of every column already exists.
+	bool first;
+	/// The number of lines parsed.
+	int lines;
+	/// The first line parsed into every column.
+	struct AS_LLElement **heads;
+	/// The last line parsed into every column, NULL if nothing has been parsed into it.
+	struct AS_LLElement **tails;
+};
+
+/**
+ * Append a view of a cell onto the end of a column.
+ *
+ * @param struct AS_LLElement **current - The last line of the column (NULL if there is none), updated to the new line.
+ * @param char *contents - The start of the cell in the file's original contents.
+ * @param size_t length - The number of characters in the cell.
+ * @param bool first - Set if this is the first line of the column, in which case the existing line is used.
+ * */
+static void append_cell(struct AS_LLElement **current, char *contents, size_t length, bool first) {
+	struct AS_LLElement *element = *current;
+
+	if (!first) {
+		element = new_line_list_element(NULL, 0);
+
+		// Link it onto the end of the column
+		element->prev = *current;
+
+		if (*current != NULL) {
+			(*current)->next = element;
+		}
 
-		if (line_count == text_file->cy) {
-			for (int i = 0; i < column_count; i++) {
-				text_file->buffers[i]->current_element = currents[i]->prev;
+		*current = element;
+	}
+
+	element->contents = (length > 0) ? contents : NULL;
+	element->length = length;
+}
+
+/**
+ * Append a cell onto the end of a column of a segment.
+ *
+ * @param struct AS_ParseSegment *segment - The segment being parsed.
+ * @param int column - The column of the cell.
+ * @param char *contents - The start of the cell in the file's original contents.
+ * @param size_t length - The number of characters in the cell.
+ * */
+static void append_segment_cell(struct AS_ParseSegment *segment, int column, char *contents, size_t length) {
+	append_cell(&segment->tails[column], contents, length, segment->first && segment->lines == 0);
+
+	if (segment->lines == 0) {
+		segment->heads[column] = segment->tails[column];
+	}
+}
+
+/**
+ * Finish a line of a segment.
+ *
+ * Appends the last cell of the line to its column, and empty cells
+ * to every column after it.
+ *
+ * @param struct AS_ParseSegment *segment - The segment being parsed.
+ * @param int column - The column of the last cell.
+ * @param char *start - The start of the last cell.
+ * @param char *end - The end of the last cell (its newline).
+ * */
+static void finish_line(struct AS_ParseSegment *segment, int column, char *start, char *end) {
+	append_segment_cell(segment, column, start, end - start);
+
+	for (int i = column + 1; i < segment->file->buffer_count; i++) {
+		append_segment_cell(segment, i, NULL, 0);
+	}
+
+	segment->lines++;
+}
+
+/**
+ * Parse a segment of a file into lines.
+ *
+ * Job of parallel_run.
+ *
+ * @param void *argument - The array of segments.
+ * @param int i - The index of the segment to parse.
+ * */
+static void parse_segment(void *argument, int i) {
+	struct AS_ParseSegment *segment = &((struct AS_ParseSegment *)argument)[i];
+	struct AS_TextFile *text_file = segment->file;
+	int delimiter = as_ctx.col_descs[as_ctx.col_desc_i].delimiter;
+	int column_count = text_file->buffer_count;
+
+	char *original = text_file->original;
+	uint32_t *offsets = (uint32_t *)malloc(sizeof(uint32_t) * AS_SCAN_BLOCK_SIZE);
+
+	// Start of the current cell and its column
+	size_t cell_start = segment->start;
+	int column = 0;
+
+	for (size_t block = segment->start; block < segment->end; block += AS_SCAN_BLOCK_SIZE) {
+		size_t count = scan_block(original + block, min(segment->end - block, (size_t)AS_SCAN_BLOCK_SIZE), delimiter, offsets);
+
+		for (size_t j = 0; j < count; j++) {
+			size_t offset = block + offsets[j];
+
+			if (original[offset] != '\n') {
+				// Delimiter, the last column takes the
+				// rest of the line
+				if (column < column_count - 1) {
+					append_segment_cell(segment, column, original + cell_start, offset - cell_start);
+					column++;
+					cell_start = offset + 1;
+				}
+
+				continue;
 			}
+
+			finish_line(segment, column, original + cell_start, original + offset);
+
+			column = 0;
+			cell_start = offset + 1;
 		}
+	}
 
-                line_count++;
+	if (cell_start < segment->end || column > 0) {
+		// The last line of the file has no newline
+		finish_line(segment, column, original + cell_start, original + segment->end);
+	}
 
-                // Memory Manage
-                free(contents);
-                contents = NULL;
-        }
+	// Memory Manage
+	free(offsets);
+}
+
+/**
+ * Split the unparsed contents of a file into segments.
+ *
+ * Every segment is at least AS_LOAD_CHUNK_SIZE bytes, and ends just past
+ * a newline or at the end of the file.
+ *
+ * @param struct AS_TextFile *text_file - The file being loaded.
+ * @param struct AS_ParseSegment *segments - Filled in with the ranges of the segments.
+ * @param int count - The most segments to make.
+ * @param size_t length - The number of bytes to split between the segments.
+ * @return The number of segments made.
+ * */
+static int split_segments(struct AS_TextFile *text_file, struct AS_ParseSegment *segments, int count, size_t length) {
+	char *original = text_file->original;
+	size_t size = text_file->original_size;
+	size_t start = text_file->load_end;
+	size_t step = max(length / count, (size_t)AS_LOAD_CHUNK_SIZE);
+
+	int made = 0;
 
-	if (line_count <= 1) {
-		for (int i = 0; (i < column_count); i++) {
-			currents[i]->contents = (char *)malloc(1);
-			*(currents[i]->contents) = 0;
-			currents[i]->next = NULL;
+	while (made < count && start < size) {
+		size_t end = size;
+
+		if (size - start > step) {
+			// End after the line the step lands in
+			char *newline = (char *)memchr(original + start + step, '\n', size - start - step);
+			end = (newline == NULL) ? size : (size_t)(newline - original) + 1;
 		}
-	} else {
-		for (int i = 0; (i < column_count); i++) {
-			currents[i]->prev->next = NULL;
-			free(currents[i]);
+
+		segments[made].start = start;
+		segments[made].end = end;
+		made++;
+
+		start = end;
+	}
+
+	return made;
+}
+
+/**
+ * Parse lines of a file's original contents onto the ends of its columns.
+ *
+ * Parsing starts at text_file->load_end, which is always the start of a line,
+ * and stops at the end of a line once `lines` lines are loaded and at least
+ * AS_LOAD_CHUNK_SIZE bytes have been parsed, or at the end of the file.
+ *
+ * When many lines are wanted, the contents are split into a segment per
+ * processor which are parsed in parallel.
+ *
+ * @param struct AS_TextFile *text_file - The text file being loaded.
+ * @param struct AS_LLElement **currents - The last line of every column.
+ * @param int line_count - The number of lines already loaded.
+ * @param int lines - The number of lines which should be loaded.
+ * @return The number of lines loaded.
+ * */
+static int parse_lines(struct AS_TextFile *text_file, struct AS_LLElement **currents, int line_count, int lines) {
+	int column_count = text_file->buffer_count;
+	size_t size = text_file->original_size;
+	int workers = parallel_workers();
+
+	struct AS_ParseSegment *segments = (struct AS_ParseSegment *)malloc(workers * sizeof(struct AS_ParseSegment));
+	struct AS_LLElement **columns = (struct AS_LLElement **)malloc(2 * workers * column_count * sizeof(struct AS_LLElement *));
+
+	do {
+		// Guess how many bytes the missing lines take up from
+		// the lines loaded so far
+		size_t average = (line_count > 0) ? max(text_file->load_end / line_count, (size_t)1) : AS_LOAD_LINE_GUESS;
+		size_t wanted = (lines > line_count) ? (size_t)(lines - line_count) * average : 0;
+		size_t length = min(wanted, size - text_file->load_end);
+
+		int count = split_segments(text_file, segments, (int)min((size_t)workers, max(length / AS_LOAD_CHUNK_SIZE, (size_t)1)), length);
+
+		for (int i = 0; i < count; i++) {
+			segments[i].file = text_file;
+			segments[i].first = (i == 0 && line_count == 0);
+			segments[i].lines = 0;
+			segments[i].heads = columns + 2 * i * column_count;
+			segments[i].tails = segments[i].heads + column_count;
+
+			// The first segment carries on from the end of the
+			// columns, the others start lists of their own
+			for (int j = 0; j < column_count; j++) {
+				segments[i].tails[j] = (i == 0) ? currents[j] : NULL;
+			}
+		}
+
+		parallel_run(count, parse_segment, segments, NULL);
+
+		// Link the segments onto the columns in order
+		for (int i = 0; i < count; i++) {
+			struct AS_ParseSegment *segment = &segments[i];
+
+			if (segment->lines == 0) {
+				continue;
+			}
+
+			if (text_file->cy >= line_count && text_file->cy < line_count + segment->lines) {
+				// The cursor's line is in this segment
+				for (int j = 0; j < column_count; j++) {
+					struct AS_LLElement *element = segment->heads[j];
+
+					for (int k = line_count; k < text_file->cy; k++) {
+						element = element->next;
+					}
+
+					text_file->buffers[j]->current_element = element;
+				}
+			}
+
+			for (int j = 0; j < column_count; j++) {
+				if (i > 0) {
+					currents[j]->next = segment->heads[j];
+					segment->heads[j]->prev = currents[j];
+				}
+
+				currents[j] = segment->tails[j];
+			}
+
+			line_count += segment->lines;
+		}
+
+		text_file->load_end = segments[count - 1].end;
+	} while (line_count < lines && text_file->load_end < size);
+
+	if (text_file->load_end >= size && line_count == 1) {
+		// A single line file is given an empty line after it
+		for (int i = 0; i < column_count; i++) {
+			append_cell(&currents[i], NULL, 0, 0);
 		}
 	}
 
-        if (contents != NULL) {
-                free(contents);
-                contents = NULL;
+	// Memory Manage
+	free(segments);
+	free(columns);
+
+	return line_count;
+}
+
+/**
+ * Load the content of a file in the format of struct AS_TextBuf.
+ *
+ * Every cell is a view into text_file->original, nothing is copied until
+ * a line is edited. Only the lines up to a little past the cursor are
+ * loaded, the rest are loaded by load_file_lines as they are needed.
+ *
+ * @param struct AS_TextFile *text_file - The text file who's content needs to be loaded
+ * */
+void load_file_content(struct AS_TextFile *text_file) {
+	struct AS_ColDesc descriptor = as_ctx.col_descs[as_ctx.col_desc_i];
+        int column_count = descriptor.column_count;
+
+	text_file->buffer_count = column_count;
+
+        // Allocate text buffers (columns)
+        text_file->buffers = (struct AS_TextBuf **)calloc(column_count, sizeof(struct AS_TextBuf *));
+        struct AS_LLElement **currents = (struct AS_LLElement **)calloc(column_count, sizeof(struct AS_LLElement *));
+
+        for (int i = 0; i < column_count; i++) {
+                struct AS_TextBuf *buffer = new_buffer(descriptor.column_positions[i], (i + 1 >= column_count) ? -1 :
+						       descriptor.column_positions[i + 1]);
+
+                text_file->buffers[i] = buffer;
+                currents[i] = buffer->head;
+                buffer->current_element = currents[i];
         }
 
+        // Map file
+	map_original(text_file);
+
+	text_file->load_end = 0;
+
+	if (text_file->original_size > 0) {
+		parse_lines(text_file, currents, 0, text_file->cy + AS_LOAD_MARGIN_LINES);
+	}
+
         text_file->active_buffer = text_file->buffers[0];
 
-        fseek(file, 0, SEEK_SET);
+	// The lines are exactly those on disk
+	text_file->modified = 0;
+	text_file->original_lines = INT_MAX;
+
+	// Memory Manage
+	free(currents);
+}
+
+void load_file_lines(struct AS_TextFile *file, int lines) {
+	if (file->load_end >= file->original_size) {
+		// Everything is loaded
+		return;
+	}
+
+	int line_count = line_index_count(file);
+
+	if (lines <= line_count) {
+		return;
+	}
+
+	struct AS_LLElement **currents = (struct AS_LLElement **)calloc(file->buffer_count, sizeof(struct AS_LLElement *));
+
+	for (int i = 0; i < file->buffer_count; i++) {
+		currents[i] = line_index_get(file, line_count - 1, i);
+	}
+
+	int loaded = parse_lines(file, currents, line_count, lines);
+
+	line_index_append(file, loaded - line_count);
 
 	// Memory Manage
 	free(currents);
@@ -183,6 +682,10 @@ struct AS_TextFile *load_file(char *name) {
                 }
         }
 
+	// The file is mapped by load_file_content, the stream was
+	// only needed to make sure it exists
+	fclose(file);
+
 	// Get the current file.
 	struct AS_TextFile *prev = as_ctx.text_file;
 
@@ -190,9 +693,9 @@ struct AS_TextFile *load_file(char *name) {
         as_ctx.text_file = (struct AS_TextFile *)malloc(sizeof(struct AS_TextFile));
 	memset(as_ctx.text_file, 0, sizeof(struct AS_TextFile));
 
-	as_ctx.text_file->file = file;
 	as_ctx.text_file->name = strdup(name);
 	as_ctx.text_file->load_offset = 0;
+	as_ctx.text_file->syntax_backend = find_syntax_backend(name);
 
 	// Link the new text file into the list
 	if (prev != NULL) {
@@ -226,76 +729,537 @@ void reload_file(struct AS_TextFile *file) {
 		destroy_buffer(file->buffers[i]);
 	}
 
+	free(file->buffers);
+	unmap_original(file);
+
+	// All lines are gone, so are their syntax points and rows
+	arena_reset(&file->syntax_arena);
+	file->syntax_waste = 0;
+	line_index_destroy(file);
+
 	load_file_content(file);
 }
 
+/**
+ * Gather the open files into an array.
+ *
+ * @param bool modified_only - Only gather files which have been modified (1), or every file (0).
+ * @param int *count - Set to the number of files gathered.
+ * @return An array of the files, which the caller frees.
+ * */
+static struct AS_TextFile **gather_files(bool modified_only, int *count) {
+	int size = 0;
+
+	for (struct AS_TextFile *current = as_ctx.text_file_head; current != NULL; current = current->next) {
+		size++;
+	}
+
+	struct AS_TextFile **files = (struct AS_TextFile **)malloc(max(size, 1) * sizeof(struct AS_TextFile *));
+	*count = 0;
+
+	for (struct AS_TextFile *current = as_ctx.text_file_head; current != NULL; current = current->next) {
+		if (!modified_only || current->modified) {
+			files[(*count)++] = current;
+		}
+	}
+
+	return files;
+}
+
+/**
+ * Job of parallel_run which reloads a file.
+ *
+ * @param void *argument - The array of files.
+ * @param int i - The index of the file to reload.
+ * */
+static void reload_job(void *argument, int i) {
+	reload_file(((struct AS_TextFile **)argument)[i]);
+}
+
 void reload_all() {
 	AS_DEBUG_MSG("Reloading all text files\n");
 
-	struct AS_TextFile *current = as_ctx.text_file_head;
-	while (current != NULL) {
-		reload_file(current);
-		current = current->next;
+	// Files share nothing, so they are reloaded at the same time
+	int count = 0;
+	struct AS_TextFile **files = gather_files(0, &count);
+
+	parallel_run(count, reload_job, files, "RELOADING");
+
+	// Memory Manage
+	free(files);
+}
+
+/**
+ * Write everything gathered by a save writer.
+ *
+ * @param struct AS_SaveWriter *writer - The writer to flush.
+ * @return 0 on success, -1 if the write failed.
+ * */
+static int save_writer_flush(struct AS_SaveWriter *writer) {
+	struct iovec *iov = writer->iov;
+	int count = writer->count;
+
+	writer->count = 0;
+
+	while (count > 0) {
+		ssize_t written = writev(writer->fd, iov, count);
+
+		if (written == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		// Skip past what was written, a short write may
+		// end in the middle of a span
+		while (count > 0 && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
 	}
+
+	return 0;
 }
 
-// Save a given file
-void save_file(struct AS_TextFile *file) {
-	if (file == NULL) {
+/**
+ * Add a span of bytes to the end of what a save writer will write.
+ *
+ * Spans which continue the previous one, such as neighbouring unedited
+ * cells of the original file, are joined into a single iovec.
+ *
+ * @param struct AS_SaveWriter *writer - The writer.
+ * @param char *data - The bytes, which must stay valid until the writer is flushed.
+ * @param size_t length - The number of bytes.
+ * @return 0 on success, -1 if the write failed.
+ * */
+static int save_writer_push(struct AS_SaveWriter *writer, char *data, size_t length) {
+	if (length == 0) {
+		return 0;
+	}
+
+	if (writer->count > 0) {
+		struct iovec *last = &writer->iov[writer->count - 1];
+
+		if ((char *)last->iov_base + last->iov_len == data) {
+			last->iov_len += length;
+
+			return 0;
+		}
+	}
+
+	if (writer->count == AS_SAVE_IOV_COUNT && save_writer_flush(writer) == -1) {
+		return -1;
+	}
+
+	writer->iov[writer->count].iov_base = data;
+	writer->iov[writer->count].iov_len = length;
+	writer->count++;
+
+	return 0;
+}
+
+/**
+ * Add a single separator character to the end of what a save writer will write.
+ *
+ * If the previous span ends on the same character in the original file,
+ * the span is extended over it, otherwise `c` must point to storage which
+ * outlives the writer.
+ *
+ * @param struct AS_SaveWriter *writer - The writer.
+ * @param struct AS_TextFile *file - The file being saved.
+ * @param char *c - The character.
+ * @return 0 on success, -1 if the write failed.
+ * */
+static int save_writer_push_char(struct AS_SaveWriter *writer, struct AS_TextFile *file, char *c) {
+	if (writer->count > 0) {
+		struct iovec *last = &writer->iov[writer->count - 1];
+		char *end = (char *)last->iov_base + last->iov_len;
+
+		if (end >= file->original && end < file->original + file->original_size && *end == *c) {
+			last->iov_len++;
+
+			return 0;
+		}
+	}
+
+	return save_writer_push(writer, c, 1);
+}
+
+/**
+ * Find where a line starts in the original contents of a file.
+ *
+ * Every line before `line` must be unchanged since the file was loaded.
+ * The offset is found from the nearest of those lines which is still
+ * a view into the original contents, rather than from the top of the file.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int line - The 0-based index of the line.
+ * @return The offset of the line, 0 if it could not be found.
+ * */
+static size_t original_line_offset(struct AS_TextFile *file, int line) {
+	char *start = file->original;
+	char *end = file->original + file->original_size;
+	int newlines = line;
+	bool found = 0;
+
+	for (int row = line - 1; row >= 0 && !found; row--) {
+		for (int i = 0; i < file->buffer_count && !found; i++) {
+			struct AS_LLElement *element = line_index_get(file, row, i);
+
+			if (element->length > 0 && element->contents >= start && element->contents < end) {
+				start = element->contents;
+				newlines = line - row;
+				found = 1;
+			}
+		}
+	}
+
+	// Step over the newlines ending the lines in between
+	for (int i = 0; i < newlines; i++) {
+		char *newline = (char *)memchr(start, '\n', end - start);
+
+		if (newline == NULL) {
+			return 0;
+		}
+
+		start = newline + 1;
+	}
+
+	return start - file->original;
+}
+
+/**
+ * Touch every page of the original contents of a file which is mapped from
+ * the file, so that pages lost to the file being truncated are replaced
+ * (see truncation_handler) before the kernel reads them, which would fail
+ * the write rather than raise SIGBUS.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * */
+static void touch_original(struct AS_TextFile *file) {
+	if (file->mapping == NULL) {
 		return;
 	}
 
-	AS_DEBUG_MSG("Saving file %s\n", file->name);
+	volatile char *original = file->original;
+
+	for (size_t offset = 0; offset < file->original_size; offset += page_size) {
+		(void)original[offset];
+	}
+}
+
+/**
+ * Write the contents of a file to a descriptor.
+ *
+ * @param struct AS_TextFile *file - The file to write.
+ * @param int fd - The descriptor to write to.
+ * @return 0 on success, -1 if the write failed.
+ * */
+static int write_file_content(struct AS_TextFile *file, int fd) {
+	static char newline = '\n';
+	char delimiter = as_ctx.col_descs[as_ctx.col_desc_i].delimiter;
+
+	struct AS_SaveWriter *writer = (struct AS_SaveWriter *)malloc(sizeof(struct AS_SaveWriter));
+	writer->fd = fd;
+	writer->count = 0;
 
 	struct AS_LLElement **currents = (struct AS_LLElement **)calloc(file->buffer_count, sizeof(struct AS_LLElement *));
-	
+
 	for (int i = 0; i < file->buffer_count; i++) {
 		currents[i] = file->buffers[i]->head;
 	}
 
-	size_t file_size = 0;
+	touch_original(file);
+
+	int result = 0;
+	size_t prefix = (size_t)file->load_offset;
+	int line_count = line_index_count(file);
 
-	fseek(file->file, file->load_offset, SEEK_SET);
+	if (file->original_lines > 0 && file->original_lines < line_count) {
+		// The lines before the first change are copied straight
+		// out of the original contents
+		size_t offset = original_line_offset(file, file->original_lines);
 
-	while (currents[0] != NULL) {
-		for (int i = 0; i < file->buffer_count; i++) {
-			if (currents[i]->contents != NULL) {
-				file_size += fputs(currents[i]->contents, file->file);
+		if (offset > 0) {
+			prefix = max(prefix, offset);
+
+			for (int i = 0; i < file->buffer_count; i++) {
+				currents[i] = line_index_get(file, file->original_lines, i);
 			}
+		}
+	}
+
+	if (prefix > 0) {
+		// Keep everything before the load offset and unchanged lines
+		result = save_writer_push(writer, file->original, min(prefix, file->original_size));
+	}
+
+	while (currents[0] != NULL && result == 0) {
+		for (int i = 0; i < file->buffer_count && result == 0; i++) {
+			result = save_writer_push(writer, currents[i]->contents, currents[i]->length);
 
-			if (i < file->buffer_count - 1) {
-				fputc(as_ctx.col_descs[as_ctx.col_desc_i].delimiter, file->file);
-				file_size++;
+			if (result == 0 && i < file->buffer_count - 1) {
+				result = save_writer_push_char(writer, file, &delimiter);
 			}
 
 			currents[i] = currents[i]->next;
 		}
-                
-                if (currents[0] != NULL) {
-		        fputc('\n', file->file);
-			file_size++;
-                }
+
+		if (result == 0 && currents[0] != NULL) {
+			result = save_writer_push_char(writer, file, &newline);
+		}
+	}
+
+	if (result == 0 && file->load_end < file->original_size) {
+		// Lines which have not been loaded yet are unchanged
+		result = save_writer_push_char(writer, file, &newline);
+
+		if (result == 0) {
+			result = save_writer_push(writer, file->original + file->load_end, file->original_size - file->load_end);
+		}
+	} else if (result == 0 && file->original_size > 0 && file->original[file->original_size - 1] == '\n' &&
+		   memchr(file->original, '\n', file->original_size) != file->original + file->original_size - 1) {
+		// Keep the newline the file ended with, a single line file
+		// already has it as the empty line it was given when loaded
+		result = save_writer_push_char(writer, file, &newline);
 	}
 
-	ftruncate(fileno(file->file), file_size);
+	if (result == 0) {
+		result = save_writer_flush(writer);
+	}
 
 	// Memory Manage
 	free(currents);
+	free(writer);
+
+	return result;
+}
+
+/**
+ * Flush the directory entry of a file to disk, so that a rename
+ * into it survives a crash.
+ *
+ * @param char *name - The path of the file.
+ * */
+static void sync_parent_directory(char *name) {
+	char *directory = strdup(name);
+	char *slash = strrchr(directory, '/');
+
+	if (slash == directory) {
+		slash[1] = 0;
+	} else if (slash != NULL) {
+		*slash = 0;
+	} else {
+		strcpy(directory, ".");
+	}
+
+	int fd = open(directory, O_RDONLY | O_DIRECTORY);
+
+	if (fd != -1) {
+		fsync(fd);
+		close(fd);
+	}
+
+	free(directory);
+}
+
+/**
+ * Write the contents of a file over the file on disk.
+ *
+ * The file is only truncated once everything has been written,
+ * so a failed write leaves as much of the old contents as possible.
+ *
+ * @param struct AS_TextFile *file - The file to write.
+ * @param char *path - The path of the file on disk.
+ * @return 0 on success, -1 if the write failed.
+ * */
+static int save_in_place(struct AS_TextFile *file, char *path) {
+	// Unchanged lines would otherwise change under the editor as they are written
+	if (detach_original(file) == -1) {
+		AS_DEBUG_MSG("Failed to copy out the contents of %s\n", path);
+
+		return -1;
+	}
+
+	int fd = open(path, O_WRONLY | O_CREAT, 0666);
+
+	if (fd == -1) {
+		AS_DEBUG_MSG("Failed to open %s for writing\n", path);
+
+		return -1;
+	}
+
+	int result = write_file_content(file, fd);
+
+	if (result == 0) {
+		off_t end = lseek(fd, 0, SEEK_CUR);
+		result = (end == -1 || ftruncate(fd, end) == -1 || fsync(fd) == -1) ? -1 : 0;
+	}
+
+	if (result == -1) {
+		AS_DEBUG_MSG("Failed to write %s\n", path);
+	}
+
+	close(fd);
+
+	return result;
+}
+
+/**
+ * Write the contents of a file to a temporary file beside it and
+ * rename it over the file.
+ *
+ * @param struct AS_TextFile *file - The file to write.
+ * @param char *path - The path of the file on disk, with no symbolic links.
+ * @param struct stat *st - The status of the file on disk, NULL if it does not exist.
+ * @return 0 on success, 1 if no temporary file could take the file's place, -1 if the write failed.
+ * */
+static int save_by_rename(struct AS_TextFile *file, char *path, struct stat *st) {
+	char *tmp_name = (char *)malloc(strlen(path) + strlen(".XXXXXX") + 1);
+	sprintf(tmp_name, "%s.XXXXXX", path);
+
+	int fd = mkstemp(tmp_name);
+
+	if (fd == -1) {
+		// The directory is not writable, or the name is too long
+		// to be extended
+		AS_DEBUG_MSG("Failed to create a temporary file for %s\n", path);
+		free(tmp_name);
+
+		return 1;
+	}
+
+	// Keep the owner and permissions of the file, a new file gets
+	// the permissions open would have given it rather than mkstemp's 0600
+	if (st == NULL && fchmod(fd, 0666 & ~as_ctx.file_mask) == -1) {
+		AS_DEBUG_MSG("Failed to set the permissions of %s\n", tmp_name);
+	}
+
+	if (st != NULL && (fchown(fd, st->st_uid, st->st_gid) == -1 || fchmod(fd, st->st_mode & 07777) == -1)) {
+		AS_DEBUG_MSG("Failed to give %s the owner of %s\n", tmp_name, path);
+		close(fd);
+		unlink(tmp_name);
+		free(tmp_name);
+
+		return 1;
+	}
+
+	int result = 0;
+
+	if (write_file_content(file, fd) == -1 || fsync(fd) == -1) {
+		AS_DEBUG_MSG("Failed to write %s\n", tmp_name);
+		result = -1;
+	}
+
+	close(fd);
+
+	if (result == 0 && rename(tmp_name, path) == -1) {
+		AS_DEBUG_MSG("Failed to replace %s with %s\n", path, tmp_name);
+		result = -1;
+	}
+
+	if (result == 0) {
+		sync_parent_directory(path);
+	} else {
+		unlink(tmp_name);
+	}
 
-	// TODO: Find a better way to do this. This is bad
-	fclose(file->file);
-	file->file = fopen(file->name, "r+");
+	// Memory Manage
+	free(tmp_name);
+
+	return result;
+}
+
+// Save a given file
+int save_file(struct AS_TextFile *file) {
+	if (file == NULL) {
+		return -1;
+	}
+
+	AS_DEBUG_MSG("Saving file %s\n", file->name);
+
+	// Write through symbolic links to the file they point at
+	char *path = realpath(file->name, NULL);
+
+	if (path == NULL) {
+		path = strdup(file->name);
+	}
+
+	struct stat st;
+	bool exists = (stat(path, &st) == 0);
+
+	// A temporary copy renamed over the file leaves the file either
+	// entirely old or entirely new should the save be interrupted.
+	// Hard links would be split from the file, so those are written
+	// in place, as is any file no temporary copy can be made for.
+	int result = 1;
+
+	if (!exists || st.st_nlink <= 1) {
+		result = save_by_rename(file, path, exists ? &st : NULL);
+	}
+
+	if (result == 1) {
+		result = save_in_place(file, path);
+	}
+
+	if (result == 0) {
+		file->modified = 0;
+	}
+
+	// Memory Manage
+	free(path);
+
+	return result;
+}
+
+/**
+ * Job of parallel_run which saves a file.
+ *
+ * @param void *argument - The array of files.
+ * @param int i - The index of the file to save.
+ * */
+static void save_job(void *argument, int i) {
+	struct AS_TextFile **files = (struct AS_TextFile **)argument;
+
+	if (save_file(files[i]) != 0) {
+		// Clear the slot of a file which failed to save
+		files[i] = NULL;
+	}
 }
 
 // Save all files
-void save_all() {
+int save_all() {
 	AS_DEBUG_MSG("Saving all text files\n");
 
-	struct AS_TextFile *current = as_ctx.text_file_head;
-	while (current != NULL) {
-		save_file(current);
-		current = current->next;
+	// Files which are the same as on disk are left alone
+	int count = 0;
+	struct AS_TextFile **files = gather_files(1, &count);
+
+	parallel_run(count, save_job, files, "SAVING");
+
+	int failed = 0;
+
+	for (int i = 0; i < count; i++) {
+		failed += (files[i] == NULL);
 	}
+
+	// Memory Manage
+	free(files);
+
+	return failed;
+}
+
+void mark_file_modified(struct AS_TextFile *file, int line) {
+	file->modified = 1;
+	file->original_lines = min(file->original_lines, max(line, 0));
 }
 
 // Destroy a given file
@@ -312,28 +1276,50 @@ void destroy_file(struct AS_TextFile *file) {
 		file->next->prev = file->prev;
 	}
 
-	fclose(file->file);
-	
 	for (int i = 0; i < as_ctx.col_descs[as_ctx.col_desc_i].column_count; i++) {
 		destroy_buffer(file->buffers[i]);
 	}
 
+	free(file->buffers);
+	unmap_original(file);
+	arena_destroy(&file->syntax_arena);
+	line_index_destroy(file);
+	undo_destroy(file);
 	free(file->name);
 	free(file);
 }
 
+/**
+ * Job of parallel_run which destroys a file.
+ *
+ * @param void *argument - The array of files.
+ * @param int i - The index of the file to destroy.
+ * */
+static void destroy_job(void *argument, int i) {
+	destroy_file(((struct AS_TextFile **)argument)[i]);
+}
+
 // Destroy all files
 void destroy_all() {
 	AS_DEBUG_MSG("Destroying all text files\n");
 
-	struct AS_TextFile *current = as_ctx.text_file_head;
-	while (current != NULL) {
-		destroy_file(current);
-		current = current->next;
+	int count = 0;
+	struct AS_TextFile **files = gather_files(0, &count);
+
+	// Unlink every file first, so that destroying one does not
+	// touch its neighbours
+	for (int i = 0; i < count; i++) {
+		files[i]->prev = NULL;
+		files[i]->next = NULL;
 	}
 
+	parallel_run(count, destroy_job, files, NULL);
+
 	as_ctx.text_file_head = NULL;
 	as_ctx.text_file = NULL;
+
+	// Memory Manage
+	free(files);
 }
 
 struct AS_CfgTok *configure_editor(struct AS_CfgTok *token) {
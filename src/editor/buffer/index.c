@@ -0,0 +1,365 @@
+/**
+ * @file index.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * An order-statistic index over the lines of a file, shared by all of its columns,
+ * which finds the line at a given line number in O(log n).
+*/
+
+#include <editor/buffer/index.h>
+#include <editor/buffer/editor.h>
+#include <editor/buffer/buffer.h>
+
+#include <global.h>
+#include <includes.h>
+#include <util.h>
+
+/// Get the size of a subtree, 0 if it is empty.
+#define NODE_SIZE(node) ((node) == NULL ? 0 : (node)->size)
+
+/**
+ * Recompute the size of a node from its children.
+ * */
+static void update_node(struct AS_LineIndexNode *node) {
+	node->size = 1 + NODE_SIZE(node->left) + NODE_SIZE(node->right);
+}
+
+/**
+ * Allocate a node with a random priority.
+ * */
+static struct AS_LineIndexNode *new_node(struct AS_LineIndex *index) {
+	struct AS_LineIndexNode *node = index->free_nodes;
+
+	if (node != NULL) {
+		index->free_nodes = node->left;
+	} else {
+		node = (struct AS_LineIndexNode *)arena_alloc(&index->arena, sizeof(struct AS_LineIndexNode) + index->columns * sizeof(struct AS_LLElement *));
+	}
+
+	// xorshift32
+	index->seed ^= index->seed << 13;
+	index->seed ^= index->seed >> 17;
+	index->seed ^= index->seed << 5;
+
+	node->left = NULL;
+	node->right = NULL;
+	node->priority = index->seed;
+	node->size = 1;
+
+	return node;
+}
+
+/**
+ * Split a subtree in two.
+ *
+ * @param struct AS_LineIndexNode *node - The subtree to split.
+ * @param int count - The number of rows to put into left.
+ * @param struct AS_LineIndexNode **left - Set to the first `count` rows.
+ * @param struct AS_LineIndexNode **right - Set to the remaining rows.
+ * */
+static void split(struct AS_LineIndexNode *node, int count, struct AS_LineIndexNode **left, struct AS_LineIndexNode **right) {
+	if (node == NULL) {
+		*left = NULL;
+		*right = NULL;
+
+		return;
+	}
+
+	if (NODE_SIZE(node->left) < count) {
+		split(node->right, count - NODE_SIZE(node->left) - 1, &node->right, right);
+		*left = node;
+	} else {
+		split(node->left, count, left, &node->left);
+		*right = node;
+	}
+
+	update_node(node);
+}
+
+/**
+ * Join two subtrees, all rows of left come before those of right.
+ *
+ * @return The root of the joined tree.
+ * */
+static struct AS_LineIndexNode *merge(struct AS_LineIndexNode *left, struct AS_LineIndexNode *right) {
+	if (left == NULL) {
+		return right;
+	}
+
+	if (right == NULL) {
+		return left;
+	}
+
+	if (left->priority > right->priority) {
+		left->right = merge(left->right, right);
+		update_node(left);
+
+		return left;
+	}
+
+	right->left = merge(left, right->left);
+	update_node(right);
+
+	return right;
+}
+
+/**
+ * Find the node at a row.
+ *
+ * @return The node, NULL if row is out of range.
+ * */
+static struct AS_LineIndexNode *find_node(struct AS_LineIndexNode *node, int row) {
+	while (node != NULL) {
+		int left = NODE_SIZE(node->left);
+
+		if (row == left) {
+			return node;
+		}
+
+		if (row < left) {
+			node = node->left;
+		} else {
+			row -= left + 1;
+			node = node->right;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Compute the sizes of a freshly built subtree.
+ * */
+static void compute_sizes(struct AS_LineIndexNode *node) {
+	if (node == NULL) {
+		return;
+	}
+
+	compute_sizes(node->left);
+	compute_sizes(node->right);
+	update_node(node);
+}
+
+/**
+ * Build a treap over rows of the column lists.
+ *
+ * The nodes arrive in order, so the treap is built in linear time
+ * by keeping the right spine on a stack.
+ *
+ * @param struct AS_LineIndex *index - The index the nodes belong to.
+ * @param struct AS_LLElement **currents - The line of each column at the first row, advanced to the end of the lists.
+ * @return The root of the treap, NULL if there were no rows.
+ * */
+static struct AS_LineIndexNode *build_tree(struct AS_LineIndex *index, struct AS_LLElement **currents) {
+	int stack_size = 64;
+	int stack_ptr = 0;
+	struct AS_LineIndexNode **stack = (struct AS_LineIndexNode **)malloc(stack_size * sizeof(struct AS_LineIndexNode *));
+
+	while (currents[0] != NULL) {
+		struct AS_LineIndexNode *node = new_node(index);
+
+		for (int i = 0; i < index->columns; i++) {
+			node->cells[i] = currents[i];
+			currents[i] = (currents[i] != NULL) ? currents[i]->next : NULL;
+		}
+
+		// Nodes of lower priority on the right spine become
+		// the new node's left subtree
+		struct AS_LineIndexNode *last = NULL;
+
+		while (stack_ptr > 0 && stack[stack_ptr - 1]->priority < node->priority) {
+			last = stack[--stack_ptr];
+		}
+
+		node->left = last;
+
+		if (stack_ptr > 0) {
+			stack[stack_ptr - 1]->right = node;
+		}
+
+		if (stack_ptr >= stack_size) {
+			stack_size *= 2;
+			stack = (struct AS_LineIndexNode **)realloc(stack, stack_size * sizeof(struct AS_LineIndexNode *));
+		}
+
+		stack[stack_ptr++] = node;
+	}
+
+	struct AS_LineIndexNode *root = (stack_ptr > 0) ? stack[0] : NULL;
+	compute_sizes(root);
+
+	free(stack);
+
+	return root;
+}
+
+/**
+ * Build the index of a file from its column lists.
+ * */
+static void build_index(struct AS_TextFile *file) {
+	struct AS_LineIndex *index = &file->line_index;
+
+	index->columns = file->buffer_count;
+	index->seed = 0x9E3779B9;
+	index->built = 1;
+
+	struct AS_LLElement **currents = (struct AS_LLElement **)calloc(index->columns, sizeof(struct AS_LLElement *));
+
+	for (int i = 0; i < index->columns; i++) {
+		currents[i] = file->buffers[i]->head;
+	}
+
+	index->root = build_tree(index, currents);
+
+	free(currents);
+}
+
+int line_index_count(struct AS_TextFile *file) {
+	if (!file->line_index.built) {
+		build_index(file);
+	}
+
+	return NODE_SIZE(file->line_index.root);
+}
+
+struct AS_LLElement *line_index_get(struct AS_TextFile *file, int row, int column) {
+	if (!file->line_index.built) {
+		build_index(file);
+	}
+
+	struct AS_LineIndexNode *node = find_node(file->line_index.root, row);
+
+	if (node == NULL || column < 0 || column >= file->line_index.columns) {
+		return NULL;
+	}
+
+	return node->cells[column];
+}
+
+void line_index_insert(struct AS_TextFile *file, int row) {
+	line_index_insert_rows(file, row, 1);
+}
+
+void line_index_insert_rows(struct AS_TextFile *file, int row, int count) {
+	struct AS_LineIndex *index = &file->line_index;
+
+	if (!index->built || count <= 0) {
+		return;
+	}
+
+	struct AS_LineIndexNode *left = NULL;
+	struct AS_LineIndexNode *right = NULL;
+	struct AS_LineIndexNode *rows = NULL;
+
+	for (int i = 0; i < count; i++) {
+		rows = merge(rows, new_node(index));
+	}
+
+	split(index->root, row, &left, &right);
+	index->root = merge(merge(left, rows), right);
+
+	// Lines may have been linked in before or after the line
+	// at the cursor, depending on the column
+	line_index_refresh(file, row - 1, row + count);
+}
+
+void line_index_erase(struct AS_TextFile *file, int row) {
+	struct AS_LineIndex *index = &file->line_index;
+
+	if (!index->built) {
+		return;
+	}
+
+	struct AS_LineIndexNode *left = NULL;
+	struct AS_LineIndexNode *middle = NULL;
+	struct AS_LineIndexNode *right = NULL;
+
+	split(index->root, row, &left, &right);
+	split(right, 1, &middle, &right);
+
+	if (middle != NULL) {
+		middle->left = index->free_nodes;
+		index->free_nodes = middle;
+	}
+
+	index->root = merge(left, right);
+
+	line_index_refresh(file, row, row);
+}
+
+void line_index_append(struct AS_TextFile *file, int count) {
+	struct AS_LineIndex *index = &file->line_index;
+
+	if (!index->built || count <= 0) {
+		return;
+	}
+
+	struct AS_LineIndexNode *last = find_node(index->root, NODE_SIZE(index->root) - 1);
+	struct AS_LLElement **currents = (struct AS_LLElement **)calloc(index->columns, sizeof(struct AS_LLElement *));
+
+	for (int i = 0; i < index->columns; i++) {
+		currents[i] = (last != NULL) ? last->cells[i]->next : file->buffers[i]->head;
+	}
+
+	// The new rows all come after the existing ones, so they
+	// are built on their own and joined on
+	index->root = merge(index->root, build_tree(index, currents));
+
+	free(currents);
+}
+
+void line_index_refresh(struct AS_TextFile *file, int first, int last) {
+	struct AS_LineIndex *index = &file->line_index;
+
+	if (!index->built) {
+		return;
+	}
+
+	first = max(first, 0);
+	last = min(last, NODE_SIZE(index->root) - 1);
+
+	struct AS_LineIndexNode *previous = (first > 0) ? find_node(index->root, first - 1) : NULL;
+
+	for (int row = first; row <= last; row++) {
+		struct AS_LineIndexNode *node = find_node(index->root, row);
+
+		// Each row follows the one before it in every column
+		for (int i = 0; i < index->columns; i++) {
+			if (previous == NULL) {
+				node->cells[i] = file->buffers[i]->head;
+			} else {
+				node->cells[i] = (previous->cells[i] != NULL) ? previous->cells[i]->next : NULL;
+			}
+		}
+
+		previous = node;
+	}
+}
+
+void line_index_destroy(struct AS_TextFile *file) {
+	arena_destroy(&file->line_index.arena);
+	memset(&file->line_index, 0, sizeof(struct AS_LineIndex));
+}
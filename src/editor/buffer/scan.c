@@ -0,0 +1,189 @@
+/**
+ * @file scan.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Finds newlines and column delimiters in blocks of text, using the widest vector
+ * instructions the processor supports.
+*/
+
+#include <editor/buffer/scan.h>
+
+#include <global.h>
+#include <includes.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define AS_SCAN_X86
+#endif
+
+/**
+ * Scan the bytes of block[i, length) one at a time.
+ *
+ * Used for whatever is left over after the wider implementations.
+ *
+ * @return The new number of offsets.
+ * */
+static size_t scan_tail(const char *block, size_t i, size_t length, char delimiter, uint32_t *offsets, size_t count) {
+	for (; i < length; i++) {
+		if (block[i] == '\n' || block[i] == delimiter) {
+			offsets[count++] = i;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Portable implementation of scan_block.
+ *
+ * Compares eight bytes at a time using the "has zero byte" trick,
+ * only looking at individual bytes of words which contain a match.
+ * */
+static size_t scan_block_portable(const char *block, size_t length, char delimiter, uint32_t *offsets) {
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t highs = 0x8080808080808080ULL;
+	const uint64_t newlines = ones * '\n';
+	const uint64_t delimiters = ones * (uint8_t)delimiter;
+
+	size_t count = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, block + i, 8);
+
+		uint64_t n = word ^ newlines;
+		uint64_t d = word ^ delimiters;
+
+		if ((((n - ones) & ~n) | ((d - ones) & ~d)) & highs) {
+			// Some byte of this word matched, find out which
+			for (int j = 0; j < 8; j++) {
+				if (block[i + j] == '\n' || block[i + j] == delimiter) {
+					offsets[count++] = i + j;
+				}
+			}
+		}
+	}
+
+	return scan_tail(block, i, length, delimiter, offsets, count);
+}
+
+#ifdef AS_SCAN_X86
+/**
+ * SSE2 implementation of scan_block.
+ *
+ * Compares sixteen bytes at a time.
+ * */
+__attribute__((target("sse2")))
+static size_t scan_block_sse2(const char *block, size_t length, char delimiter, uint32_t *offsets) {
+	const __m128i newlines = _mm_set1_epi8('\n');
+	const __m128i delimiters = _mm_set1_epi8(delimiter);
+
+	size_t count = 0;
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(block + i));
+		uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newlines),
+							      _mm_cmpeq_epi8(chunk, delimiters)));
+
+		// Emit one offset per set bit
+		while (mask != 0) {
+			offsets[count++] = i + __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return scan_tail(block, i, length, delimiter, offsets, count);
+}
+
+/**
+ * AVX2 implementation of scan_block.
+ *
+ * Compares thirty-two bytes at a time.
+ * */
+__attribute__((target("avx2")))
+static size_t scan_block_avx2(const char *block, size_t length, char delimiter, uint32_t *offsets) {
+	const __m256i newlines = _mm256_set1_epi8('\n');
+	const __m256i delimiters = _mm256_set1_epi8(delimiter);
+
+	size_t count = 0;
+	size_t i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(block + i));
+		uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, newlines),
+								    _mm256_cmpeq_epi8(chunk, delimiters)));
+
+		// Emit one offset per set bit
+		while (mask != 0) {
+			offsets[count++] = i + __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return scan_tail(block, i, length, delimiter, offsets, count);
+}
+#endif
+
+/**
+ * Select the implementation of scan_block.
+ *
+ * Replaces scan_implementation with the widest implementation
+ * the processor supports, then scans the block with it. Workers
+ * parsing segments of a file may select at the same time, they
+ * all store the same implementation.
+ * */
+static size_t scan_block_select(const char *block, size_t length, char delimiter, uint32_t *offsets);
+
+/**
+ * The implementation of scan_block in use.
+ * */
+static size_t (*scan_implementation)(const char *, size_t, char, uint32_t *) = scan_block_select;
+
+static size_t scan_block_select(const char *block, size_t length, char delimiter, uint32_t *offsets) {
+	size_t (*implementation)(const char *, size_t, char, uint32_t *) = scan_block_portable;
+
+	#ifdef AS_SCAN_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) {
+			implementation = scan_block_avx2;
+			AS_DEBUG_MSG("Using AVX2 scanner\n");
+		} else if (__builtin_cpu_supports("sse2")) {
+			implementation = scan_block_sse2;
+			AS_DEBUG_MSG("Using SSE2 scanner\n");
+		}
+	#endif
+
+	__atomic_store_n(&scan_implementation, implementation, __ATOMIC_RELEASE);
+
+	return implementation(block, length, delimiter, offsets);
+}
+
+size_t scan_block(const char *block, size_t length, char delimiter, uint32_t *offsets) {
+	return __atomic_load_n(&scan_implementation, __ATOMIC_ACQUIRE)(block, length, delimiter, offsets);
+}
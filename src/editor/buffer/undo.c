@@ -0,0 +1,708 @@
+/**
+ * @file undo.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Journals the changes made to files as the operations which reverse them,
+ * so that memory is only spent on what was changed.
+*/
+
+#include <editor/buffer/undo.h>
+#include <editor/buffer/editor.h>
+#include <editor/buffer/buffer.h>
+#include <editor/syntax/syntax.h>
+
+#include <global.h>
+#include <includes.h>
+
+/**
+ * Get the memory used by a change.
+ * */
+static size_t entry_size(struct AS_UndoEntry *entry) {
+	return sizeof(struct AS_UndoEntry) + entry->capacity;
+}
+
+/**
+ * Free a change.
+ * */
+static void free_entry(struct AS_UndoLog *log, struct AS_UndoEntry *entry) {
+	log->size -= entry_size(entry);
+
+	free(entry->data);
+	free(entry);
+}
+
+/**
+ * Free every change which could be redone.
+ * */
+static void drop_redo(struct AS_UndoLog *log) {
+	while (log->redo != NULL) {
+		struct AS_UndoEntry *next = log->redo->next;
+		free_entry(log, log->redo);
+		log->redo = next;
+	}
+}
+
+/**
+ * Free the oldest changes until the journal fits in as_ctx.undo_limit.
+ *
+ * A group is undone in one step, so it is freed whole. If that is the
+ * group being recorded, the rest of its changes are not recorded either.
+ * */
+static void trim(struct AS_UndoLog *log) {
+	while (log->size > as_ctx.undo_limit && log->oldest != NULL) {
+		int group = log->oldest->group;
+
+		while (log->oldest != NULL && log->oldest->group == group) {
+			struct AS_UndoEntry *entry = log->oldest;
+
+			log->oldest = entry->next;
+
+			if (log->oldest != NULL) {
+				log->oldest->prev = NULL;
+			} else {
+				log->newest = NULL;
+			}
+
+			free_entry(log, entry);
+		}
+
+		if (log->grouped && group == log->group) {
+			log->dropped = 1;
+		}
+	}
+}
+
+/**
+ * Grow the data of a change to hold at least `length` bytes.
+ * */
+static void entry_reserve(struct AS_UndoLog *log, struct AS_UndoEntry *entry, size_t length) {
+	if (length <= entry->capacity) {
+		return;
+	}
+
+	size_t capacity = max(entry->capacity * 2, (size_t)16);
+
+	while (capacity < length) {
+		capacity *= 2;
+	}
+
+	log->size += capacity - entry->capacity;
+
+	entry->data = (char *)realloc(entry->data, capacity);
+	entry->capacity = capacity;
+}
+
+/**
+ * Add a change to the newest end of a file's journal.
+ *
+ * Anything which could be redone is dropped, as it no longer
+ * applies to the file.
+ *
+ * @return The new change.
+ * */
+static struct AS_UndoEntry *push_entry(struct AS_TextFile *file, int type, int row, int column, const void *data, size_t length) {
+	struct AS_UndoLog *log = &file->undo;
+
+	drop_redo(log);
+
+	struct AS_UndoEntry *entry = (struct AS_UndoEntry *)calloc(1, sizeof(struct AS_UndoEntry));
+
+	entry->type = type;
+	entry->row = row;
+	entry->column = column;
+
+	if (!log->grouped) {
+		log->group++;
+	}
+
+	entry->group = log->group;
+
+	if (length > 0) {
+		entry_reserve(log, entry, length);
+		memcpy(entry->data, data, length);
+		entry->length = length;
+	}
+
+	// Link it on as the newest change
+	entry->prev = log->newest;
+
+	if (log->newest != NULL) {
+		log->newest->next = entry;
+	} else {
+		log->oldest = entry;
+	}
+
+	log->newest = entry;
+	log->size += sizeof(struct AS_UndoEntry);
+
+	return entry;
+}
+
+/**
+ * Place the cursor of a file.
+ * */
+static void place_cursor(struct AS_TextFile *file, int row, int column, int x) {
+	column = min(max(column, 0), file->buffer_count - 1);
+
+	file->cy = min(max(row, 0), line_index_count(file) - 1);
+	file->active_buffer_idx = column;
+	file->active_buffer = file->buffers[column];
+	file->active_buffer->cx = max(x, 0);
+}
+
+/**
+ * Split a row in two.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based row to split.
+ * @param int *xs - Where to split each column.
+ * */
+static void split_row(struct AS_TextFile *file, int row, int *xs) {
+	for (int i = 0; i < file->buffer_count; i++) {
+		struct AS_LLElement *element = line_index_get(file, row, i);
+		size_t x = min((size_t)max(xs[i], 0), element->length);
+
+		// Move everything after x onto a new line after it
+		struct AS_LLElement *next = new_line_list_element(element->contents + x, element->length - x);
+
+		next->prev = element;
+		next->next = element->next;
+
+		if (element->next != NULL) {
+			element->next->prev = next;
+		}
+
+		element->next = next;
+
+		line_erase(element, x, element->length - x);
+	}
+
+	line_index_insert(file, row + 1);
+	mark_file_modified(file, row);
+}
+
+/**
+ * Join a row onto the end of the one before it.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based row which the row after it is joined onto.
+ * */
+static void join_row(struct AS_TextFile *file, int row) {
+	for (int i = 0; i < file->buffer_count; i++) {
+		struct AS_TextBuf *buffer = file->buffers[i];
+		struct AS_LLElement *element = line_index_get(file, row, i);
+		struct AS_LLElement *next = element->next;
+
+		if (next == NULL) {
+			continue;
+		}
+
+		line_insert(element, element->length, next->contents, next->length);
+
+		// Unlink the joined line
+		element->next = next->next;
+
+		if (next->next != NULL) {
+			next->next->prev = element;
+		}
+
+		if (buffer->virtual_head == next) {
+			buffer->virtual_head = element;
+		}
+
+		if (buffer->current_element == next) {
+			buffer->current_element = element;
+		}
+
+		// Memory Manage
+		file->syntax_waste += next->syntax_capacity * sizeof(struct AS_SyntaxPoint);
+		free_line_list_element(next);
+	}
+
+	line_index_erase(file, row + 1);
+	mark_file_modified(file, row);
+}
+
+/**
+ * Move lines of a column up a row, the line above them goes below them.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int column - The 0-based column.
+ * @param int first - The first row to move.
+ * @param int last - The last row to move.
+ * */
+static void move_rows_up(struct AS_TextFile *file, int column, int first, int last) {
+	struct AS_TextBuf *buffer = file->buffers[column];
+	struct AS_LLElement *element = line_index_get(file, first - 1, column);
+	struct AS_LLElement *target = line_index_get(file, last, column);
+
+	if (element == NULL || target == NULL || element == target) {
+		return;
+	}
+
+	// Unlink the line above
+	if (element->prev != NULL) {
+		element->prev->next = element->next;
+	} else {
+		buffer->head = element->next;
+	}
+
+	element->next->prev = element->prev;
+
+	// Link it in after the last line
+	element->prev = target;
+	element->next = target->next;
+
+	if (target->next != NULL) {
+		target->next->prev = element;
+	}
+
+	target->next = element;
+
+	line_index_refresh(file, first - 1, last);
+	mark_file_modified(file, first - 1);
+}
+
+/**
+ * Move lines of a column down a row, the line below them goes above them.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int column - The 0-based column.
+ * @param int first - The first row to move.
+ * @param int last - The last row to move.
+ * */
+static void move_rows_down(struct AS_TextFile *file, int column, int first, int last) {
+	struct AS_TextBuf *buffer = file->buffers[column];
+	struct AS_LLElement *element = line_index_get(file, last + 1, column);
+	struct AS_LLElement *target = line_index_get(file, first, column);
+
+	if (element == NULL || target == NULL || element == target) {
+		return;
+	}
+
+	// Unlink the line below
+	element->prev->next = element->next;
+
+	if (element->next != NULL) {
+		element->next->prev = element->prev;
+	}
+
+	// Link it in before the first line
+	element->next = target;
+	element->prev = target->prev;
+
+	if (target->prev != NULL) {
+		target->prev->next = element;
+	} else {
+		buffer->head = element;
+	}
+
+	target->prev = element;
+
+	line_index_refresh(file, first, last + 1);
+	mark_file_modified(file, first);
+}
+
+/**
+ * Repartition every file into a column layout.
+ *
+ * Every file needs to have been saved.
+ *
+ * @param int layout - The index of the column descriptor.
+ * */
+static void switch_layout(int layout) {
+	as_ctx.col_desc_i = layout;
+	reload_all();
+}
+
+/**
+ * Make a change, or reverse it.
+ *
+ * @param struct AS_TextFile *file - The file the change was made to.
+ * @param struct AS_UndoEntry *entry - The change.
+ * @param bool forward - Set to make the change, clear to reverse it.
+ * */
+static void apply_entry(struct AS_TextFile *file, struct AS_UndoEntry *entry, bool forward) {
+	int *xs = (int *)entry->data;
+
+	if (entry->type != AS_UNDO_LAYOUT) {
+		// The rows may not have been loaded since a reload
+		load_file_lines(file, max(entry->row, entry->last) + 2);
+	}
+
+	switch (entry->type) {
+	case AS_UNDO_INSERT:
+	case AS_UNDO_DELETE: {
+		struct AS_LLElement *element = line_index_get(file, entry->row, entry->column);
+
+		if (forward == (entry->type == AS_UNDO_INSERT)) {
+			line_insert(element, entry->x, entry->data, entry->length);
+
+			if (entry->type == AS_UNDO_DELETE) {
+				// Deleted text is kept last character first
+				char *text = element->contents + min((size_t)entry->x, element->length - entry->length);
+
+				for (size_t i = 0; i < entry->length / 2; i++) {
+					char c = text[i];
+					text[i] = text[entry->length - 1 - i];
+					text[entry->length - 1 - i] = c;
+				}
+			}
+
+			place_cursor(file, entry->row, entry->column, entry->x + entry->length);
+		} else {
+			line_erase(element, entry->x, entry->length);
+			place_cursor(file, entry->row, entry->column, entry->x);
+		}
+
+		mark_file_modified(file, entry->row);
+
+		break;
+	}
+
+	case AS_UNDO_SPLIT:
+	case AS_UNDO_JOIN: {
+		if (forward == (entry->type == AS_UNDO_SPLIT)) {
+			split_row(file, entry->row, xs);
+			place_cursor(file, entry->row + 1, entry->column, 0);
+		} else {
+			join_row(file, entry->row);
+			place_cursor(file, entry->row, entry->column, xs[entry->column]);
+		}
+
+		break;
+	}
+
+	case AS_UNDO_MOVE_UP:
+	case AS_UNDO_MOVE_DOWN: {
+		// Moving lines up is reversed by moving them back down
+		// from where they ended up, and the other way around
+		int up = forward == (entry->type == AS_UNDO_MOVE_UP);
+		int shift = forward ? 0 : (entry->type == AS_UNDO_MOVE_UP ? -1 : 1);
+
+		if (up) {
+			move_rows_up(file, entry->column, entry->row + shift, entry->last + shift);
+		} else {
+			move_rows_down(file, entry->column, entry->row + shift, entry->last + shift);
+		}
+
+		place_cursor(file, entry->row + shift + (up ? -1 : 1), entry->column, 0);
+
+		break;
+	}
+
+	case AS_UNDO_LAYOUT: {
+		switch_layout(forward ? entry->last : entry->x);
+		place_cursor(file, file->cy, 0, 0);
+
+		break;
+	}
+	}
+}
+
+/**
+ * Keep the journals of other files in step with a layout switch
+ * being undone or redone.
+ *
+ * Other files whose next change is the same switch have it moved
+ * across with this one. The changes of any other file were made in
+ * a layout it is no longer in, so its journal is cleared.
+ *
+ * @param struct AS_TextFile *file - The file the switch is being undone or redone in.
+ * @param struct AS_UndoEntry *entry - The switch.
+ * @param bool forward - Set if the switch is being redone, clear if undone.
+ * */
+static void move_layout_entries(struct AS_TextFile *file, struct AS_UndoEntry *entry, bool forward) {
+	for (struct AS_TextFile *other = as_ctx.text_file_head; other != NULL; other = other->next) {
+		if (other == file) {
+			continue;
+		}
+
+		struct AS_UndoLog *log = &other->undo;
+		struct AS_UndoEntry *next = forward ? log->redo : log->newest;
+
+		if (next == NULL || next->type != AS_UNDO_LAYOUT || next->x != entry->x || next->last != entry->last) {
+			undo_destroy(other);
+
+			continue;
+		}
+
+		if (forward) {
+			log->redo = next->next;
+
+			next->prev = log->newest;
+			next->next = NULL;
+
+			if (log->newest != NULL) {
+				log->newest->next = next;
+			} else {
+				log->oldest = next;
+			}
+
+			log->newest = next;
+		} else {
+			log->newest = next->prev;
+
+			if (log->newest != NULL) {
+				log->newest->next = NULL;
+			} else {
+				log->oldest = NULL;
+			}
+
+			next->prev = NULL;
+			next->next = log->redo;
+			log->redo = next;
+		}
+	}
+}
+
+/**
+ * Clear the selections of a file, as the lines they start
+ * on may be gone.
+ * */
+static void clear_selection(struct AS_TextFile *file) {
+	for (int i = 0; i < file->buffer_count; i++) {
+		file->buffers[i]->selection_enabled = 0;
+		file->buffers[i]->selection_start_line = NULL;
+	}
+
+	file->selected_buffers = 0;
+}
+
+void undo_begin(struct AS_TextFile *file) {
+	file->undo.group++;
+	file->undo.grouped = 1;
+	file->undo.dropped = 0;
+}
+
+void undo_end(struct AS_TextFile *file) {
+	file->undo.grouped = 0;
+	file->undo.dropped = 0;
+}
+
+void undo_record_insert(struct AS_TextFile *file, int row, int column, int x, const char *text, size_t length) {
+	struct AS_UndoLog *log = &file->undo;
+	struct AS_UndoEntry *newest = log->newest;
+
+	if (log->dropped) {
+		// Part of a group which was too large to journal
+		return;
+	}
+
+	drop_redo(log);
+
+	// Typing carries on the newest insertion, a new word starts a new one.
+	// Insertions never carry on into or out of a group of changes
+	bool same_group = (newest != NULL) && (log->grouped ? newest->group == log->group :
+					       (newest->prev == NULL || newest->prev->group != newest->group));
+
+	if (same_group && newest->type == AS_UNDO_INSERT && newest->row == row && newest->column == column &&
+	    newest->x + (int)newest->length == x && !(isspace((unsigned char)*text) && !isspace((unsigned char)newest->data[newest->length - 1]))) {
+		entry_reserve(log, newest, newest->length + length);
+		memcpy(newest->data + newest->length, text, length);
+		newest->length += length;
+	} else {
+		struct AS_UndoEntry *entry = push_entry(file, AS_UNDO_INSERT, row, column, text, length);
+		entry->x = x;
+	}
+
+	trim(log);
+}
+
+void undo_record_delete(struct AS_TextFile *file, int row, int column, int x, const char *text, size_t length) {
+	struct AS_UndoLog *log = &file->undo;
+	struct AS_UndoEntry *newest = log->newest;
+
+	if (log->dropped) {
+		// Part of a group which was too large to journal
+		return;
+	}
+
+	drop_redo(log);
+
+	// Deleting backwards carries on the newest deletion. The text is
+	// kept last character first, so that it is appended like typing
+	struct AS_UndoEntry *entry = newest;
+
+	if (newest == NULL || newest->type != AS_UNDO_DELETE || newest->row != row || newest->column != column ||
+	    x + (int)length != newest->x) {
+		entry = push_entry(file, AS_UNDO_DELETE, row, column, NULL, 0);
+	}
+
+	entry_reserve(log, entry, entry->length + length);
+
+	for (size_t i = 0; i < length; i++) {
+		entry->data[entry->length + i] = text[length - 1 - i];
+	}
+
+	entry->length += length;
+	entry->x = x;
+
+	trim(log);
+}
+
+void undo_record_split(struct AS_TextFile *file, int row, int column, int *xs) {
+	if (file->undo.dropped) {
+		return;
+	}
+
+	push_entry(file, AS_UNDO_SPLIT, row, column, xs, file->buffer_count * sizeof(int));
+	trim(&file->undo);
+}
+
+void undo_record_join(struct AS_TextFile *file, int row, int column, int *xs) {
+	if (file->undo.dropped) {
+		return;
+	}
+
+	push_entry(file, AS_UNDO_JOIN, row, column, xs, file->buffer_count * sizeof(int));
+	trim(&file->undo);
+}
+
+void undo_record_move(struct AS_TextFile *file, int column, int first, int last, bool up) {
+	if (file->undo.dropped) {
+		return;
+	}
+
+	struct AS_UndoEntry *entry = push_entry(file, up ? AS_UNDO_MOVE_UP : AS_UNDO_MOVE_DOWN, first, column, NULL, 0);
+	entry->last = last;
+
+	trim(&file->undo);
+}
+
+void undo_record_layout(int from, int to) {
+	for (struct AS_TextFile *file = as_ctx.text_file_head; file != NULL; file = file->next) {
+		if (file->undo.dropped) {
+			continue;
+		}
+
+		struct AS_UndoEntry *entry = push_entry(file, AS_UNDO_LAYOUT, 0, 0, NULL, 0);
+		entry->x = from;
+		entry->last = to;
+
+		trim(&file->undo);
+	}
+}
+
+int undo(struct AS_TextFile *file) {
+	struct AS_UndoLog *log = &file->undo;
+
+	if (log->newest == NULL) {
+		return 0;
+	}
+
+	// Files are reloaded in the other layout, which would lose
+	// the edits of any file which could not be saved
+	if (log->newest->type == AS_UNDO_LAYOUT && save_all() > 0) {
+		return -1;
+	}
+
+	int group = log->newest->group;
+
+	clear_selection(file);
+
+	// Reverse the group newest first, each change goes onto the
+	// redo stack so that the oldest is redone first
+	while (log->newest != NULL && log->newest->group == group) {
+		struct AS_UndoEntry *entry = log->newest;
+
+		log->newest = entry->prev;
+
+		if (log->newest != NULL) {
+			log->newest->next = NULL;
+		} else {
+			log->oldest = NULL;
+		}
+
+		if (entry->type == AS_UNDO_LAYOUT) {
+			move_layout_entries(file, entry, 0);
+		}
+
+		apply_entry(file, entry, 0);
+
+		entry->prev = NULL;
+		entry->next = log->redo;
+		log->redo = entry;
+	}
+
+	return 1;
+}
+
+int redo(struct AS_TextFile *file) {
+	struct AS_UndoLog *log = &file->undo;
+
+	if (log->redo == NULL) {
+		return 0;
+	}
+
+	if (log->redo->type == AS_UNDO_LAYOUT && save_all() > 0) {
+		return -1;
+	}
+
+	int group = log->redo->group;
+
+	clear_selection(file);
+
+	while (log->redo != NULL && log->redo->group == group) {
+		struct AS_UndoEntry *entry = log->redo;
+
+		log->redo = entry->next;
+
+		if (entry->type == AS_UNDO_LAYOUT) {
+			move_layout_entries(file, entry, 1);
+		}
+
+		apply_entry(file, entry, 1);
+
+		// Back onto the newest end of the journal
+		entry->next = NULL;
+		entry->prev = log->newest;
+
+		if (log->newest != NULL) {
+			log->newest->next = entry;
+		} else {
+			log->oldest = entry;
+		}
+
+		log->newest = entry;
+	}
+
+	return 1;
+}
+
+void undo_destroy(struct AS_TextFile *file) {
+	struct AS_UndoLog *log = &file->undo;
+
+	drop_redo(log);
+
+	while (log->newest != NULL) {
+		struct AS_UndoEntry *prev = log->newest->prev;
+		free_entry(log, log->newest);
+		log->newest = prev;
+	}
+
+	memset(log, 0, sizeof(struct AS_UndoLog));
+}
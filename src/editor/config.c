@@ -25,7 +25,9 @@
  *
  * @section DESCRIPTION
  *
- * Responsible for reading .cfg files.
+ * Responsible for reading .cfg files, and keeping the tokens of every
+ * file read at startup in a cache, so that they are only lexed again
+ * once the file changes.
 */
 
 #include <ctype.h>
@@ -34,16 +36,183 @@
 #include <editor/buffer/editor.h>
 
 #include <interface/screens/start.h>
+#include <interface/screens/editor_scr.h>
 #include <interface/theming/themes.h>
 
 #include <global.h>
 #include <util.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+
 #ifdef AS_GLIB_ENABLE
 	#include <glib-2.0/glib.h>
 	static GHashTable *lex_tokens;
 #endif
 
+/// Identifies a config cache ("ASCC" in little endian).
+#define AS_CFG_CACHE_MAGIC 0x43435341
+/// Changed whenever the layout of the config cache, or the tokens the lexer makes, change.
+#define AS_CFG_CACHE_VERSION 2
+/// The hash of no bytes (64-bit FNV-1a offset basis).
+#define AS_CFG_HASH_SEED 0xCBF29CE484222325
+/// The config cache, relative to the home directory.
+#define AS_CFG_CACHE_PATH "/.cache/assembled/config.cache"
+
+/**
+ * The start of a config cache.
+ *
+ * Followed by `entries` struct AS_CfgCacheEntry, then a 64-bit
+ * hash of everything before it.
+ * */
+struct AS_CfgCacheHeader {
+	/// AS_CFG_CACHE_MAGIC.
+	uint32_t magic;
+	/// AS_CFG_CACHE_VERSION.
+	uint32_t version;
+	/// The number of entries.
+	uint32_t entries;
+	/// Unused, zero.
+	uint32_t reserved;
+	/// keywords_hash of As_LexStrLookup, which the values of AS_CFG_TOKEN_KEY tokens index.
+	uint64_t keywords;
+};
+
+/**
+ * The tokens of a single file in the config cache.
+ *
+ * Followed by the file's path, `token_count` struct AS_CfgCacheToken,
+ * and `string_length` bytes of zero terminated strings.
+ * */
+struct AS_CfgCacheEntry {
+	/// The modification time of the file (seconds).
+	int64_t mtime_sec;
+	/// The modification time of the file (nanoseconds).
+	int64_t mtime_nsec;
+	/// The size of the file in bytes.
+	uint64_t size;
+	/// hash_bytes of the file's contents.
+	uint64_t hash;
+	/// The number of bytes in the path (not zero terminated).
+	uint32_t path_length;
+	/// The number of tokens, including the AS_CFG_TOKEN_EOF token.
+	uint32_t token_count;
+	/// The number of bytes of strings.
+	uint32_t string_length;
+	/// Unused, keeps the structure's size a multiple of 8.
+	uint32_t reserved;
+};
+
+/**
+ * A token in the config cache.
+ * */
+struct AS_CfgCacheToken {
+	/// AS_CfgTok.type
+	int32_t type;
+	/// AS_CfgTok.value
+	int32_t value;
+	/// AS_CfgTok.line
+	int32_t line;
+	/// AS_CfgTok.column
+	int32_t column;
+	/// The offset of AS_CfgTok.str within the entry's strings, -1 if it is NULL.
+	int32_t str;
+};
+
+/**
+ * A config cache built up in memory.
+ * */
+struct AS_CfgCacheBuffer {
+	/// The bytes of the cache.
+	char *data;
+	/// The number of bytes used.
+	size_t length;
+	/// The number of bytes allocated.
+	size_t capacity;
+	/// The number of entries.
+	uint32_t entries;
+};
+
+/// The config cache as read_config found it (mapped read-only), NULL if there was none or it was invalid.
+static char *cache = NULL;
+/// The size of cache in bytes.
+static size_t cache_size = 0;
+/// The cache for the next startup, made of the entries of the files read by this one.
+static struct AS_CfgCacheBuffer next_cache = { 0 };
+/// Set (1) while read_config reads files through the cache.
+static bool caching = 0;
+
+/**
+ * Hash bytes (64-bit FNV-1a).
+ *
+ * @param uint64_t hash - AS_CFG_HASH_SEED, or the hash of the bytes these follow.
+ * @param const char *data - The bytes.
+ * @param size_t length - The number of bytes.
+ * @return The hash.
+ * */
+static uint64_t hash_bytes(uint64_t hash, const char *data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (uint8_t)data[i];
+		hash *= 0x100000001B3;
+	}
+
+	return hash;
+}
+
+/**
+ * Map a file into memory, read-only.
+ *
+ * @param char *path - The file.
+ * @param struct stat *st - Set to the status of the file.
+ * @param char **data - Set to the contents, NULL if the file is empty.
+ * @return 0 on success, -1 if the file could not be opened or mapped.
+ * */
+static int map_file(char *path, struct stat *st, char **data) {
+	int fd = open(path, O_RDONLY);
+
+	*data = NULL;
+
+	if (fd == -1) {
+		return -1;
+	}
+
+	if (fstat(fd, st) == -1) {
+		close(fd);
+
+		return -1;
+	}
+
+	if (st->st_size > 0) {
+		void *map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map == MAP_FAILED) {
+			close(fd);
+
+			return -1;
+		}
+
+		*data = (char *)map;
+	}
+
+	// The mapping stays valid once the descriptor is closed
+	close(fd);
+
+	return 0;
+}
+
+/**
+ * Allocate a zeroed token.
+ *
+ * @param struct AS_Arena *arena - The arena to allocate it from.
+ * @return The token.
+ * */
+static struct AS_CfgTok *new_token(struct AS_Arena *arena) {
+	struct AS_CfgTok *token = (struct AS_CfgTok *)arena_alloc(arena, sizeof(struct AS_CfgTok));
+	memset(token, 0, sizeof(struct AS_CfgTok));
+
+	return token;
+}
+
 /**
  * Interpret the token stream for configuration files.
  *
@@ -84,6 +253,13 @@ static void interpret_token_stream(struct AS_CfgTok *token) {
 			break;
 		}
 
+		case AS_CFG_LOOKUP_EDITOR: {
+			token = configure_editor_screen(token);
+			AS_NEXT_TOKEN
+
+			break;
+		}
+
 		case AS_CFG_LOOKUP_INCLUDE: {
 			AS_EXPECT_TOKEN(AS_CFG_TOKEN_STR, "Expected string");
 			
@@ -102,29 +278,26 @@ static void interpret_token_stream(struct AS_CfgTok *token) {
 				strcat(file_path + strlen(pw->pw_dir) + 1, token->str);
 			}
 
-			FILE *file = fopen(file_path, "r");
-
 			// Read new file and interpret it
-			struct AS_CfgTok *new_stream = cfg_lex(file);
-			interpret_token_stream(new_stream);
+			struct AS_Arena arena = { 0 };
+			struct AS_CfgTok *new_stream = cfg_tokens(file_path, &arena);
 
-			AS_DEBUG_MSG("Token list:\n");
-			while (new_stream != NULL) {
-				AS_DEBUG_MSG("%d { 0x%02X, \"%s\", (%d, %d) } %p\n", new_stream->type, new_stream->value, new_stream->str, new_stream->line, new_stream->column, new_stream->next);
-				struct AS_CfgTok *tmp = new_stream->next;
+			if (new_stream == NULL) {
+				printf("Could not open file %s\n", file_path);
+				AS_DEBUG_MSG("Could not open file %s\n", file_path);
 
-				free(new_stream);
-
-				new_stream = tmp;
+				exit(1);
 			}
-			AS_DEBUG_MSG("List end\n");
+
+			interpret_token_stream(new_stream);
+
+			// Memory Manage
+			arena_destroy(&arena);
 
 			if (file_path != token->str) {
 				free(file_path);
 			}
 
-			fclose(file);
-
 			AS_NEXT_TOKEN
 		}
                 }
@@ -133,20 +306,26 @@ static void interpret_token_stream(struct AS_CfgTok *token) {
 
 // BUG?:  Trailing commas may cause errors if they are
 //        are directly followed by a comment.
-struct AS_CfgTok *cfg_lex(FILE *file) {
-        struct AS_CfgTok *head = (struct AS_CfgTok *)malloc(sizeof(struct AS_CfgTok));
-	memset(head, 0, sizeof(struct AS_CfgTok));
-	
+/**
+ * Lex the contents of a .cfg file.
+ *
+ * @param const char *data - The contents.
+ * @param size_t size - The number of bytes in data.
+ * @param struct AS_Arena *arena - The arena to allocate the tokens and their strings from.
+ * @return A pointer to the head of a struct AS_CfgTok linked list, which ends with an AS_CFG_TOKEN_EOF token.
+ * */
+static struct AS_CfgTok *lex_buffer(const char *data, size_t size, struct AS_Arena *arena) {
+        struct AS_CfgTok *head = new_token(arena);
+
         int line = 1;
         int column = 1;
-        char putback = 0;
 
-        char c = 0;
         bool comment = 0;
         struct AS_CfgTok *current = head;
-        
-        while ((c = ((putback == 0) ? fgetc(file) : putback)) != EOF) {
-                putback = 0;
+        size_t i = 0;
+
+        while (i < size) {
+                char c = data[i++];
 
                 switch (c) {
                 case '\r':
@@ -174,9 +353,8 @@ struct AS_CfgTok *cfg_lex(FILE *file) {
                         continue;
                 }
 
-                struct AS_CfgTok *next = (struct AS_CfgTok *)malloc(sizeof(struct AS_CfgTok));
-		memset(next, 0, sizeof(struct AS_CfgTok));
-		
+                struct AS_CfgTok *next = new_token(arena);
+
                 current->next = next;
                 current->line = line;
                 current->column = column;
@@ -205,37 +383,30 @@ struct AS_CfgTok *cfg_lex(FILE *file) {
                 }
 
                 case '\'': {
+			// The character, then its closing quote
                         current->type = AS_CFG_TOKEN_INT;
-                        current->value = fgetc(file);
-                        fgetc(file);
+                        current->value = (i < size) ? (uint8_t)data[i] : EOF;
+                        i += 2;
                         column += 2;
 
                         break;
                 }
 
                 default: {
-                        // Initialize a string
-                        int size = 1;
-                        char *str = (char *)malloc(size);
+			// The string starts with this character, followed by characters
+			// that are: '.', '/', '_', and alphanumeric
+                        size_t start = i - 1;
 
-			// Parse the string with characters that are: '.', '/', '_', and alphanumeric
-                        do {
-                                column++;
-
-                                if (isblank(c)) {
-                                        continue;
-                                }
-
-                                *(str + (size - 1)) = c;
-                                size++;
-                                str = (char *)realloc(str, size * sizeof(char));
-                        } while (((c = fgetc(file)) != EOF) && (isalnum(c) || c == '.' || c == '/' || c == '_'));
+                        while (i < size && (isalnum((uint8_t)data[i]) || data[i] == '.' || data[i] == '/' || data[i] == '_')) {
+                                i++;
+                        }
 
-			// Putback last read char
-                        putback = c;
+                        size_t length = i - start;
+                        column += length;
 
-			// Zero terminate string
-                        *(str + size - 1) = 0;
+                        char *str = (char *)arena_alloc(arena, length + 1);
+                        memcpy(str, data + start, length);
+                        str[length] = 0;
 
                         // Number
                         if (isdigit(*str)) {
@@ -252,10 +423,6 @@ struct AS_CfgTok *cfg_lex(FILE *file) {
                                         current->value = strtol(str, NULL, 10);
                                 }
 
-                                // String is no longer needed
-                                // Memory Manage
-                                free(str);
-
                                 break;
                         }
 
@@ -271,22 +438,14 @@ struct AS_CfgTok *cfg_lex(FILE *file) {
 					current->type = AS_CFG_TOKEN_KEY;
 					current->value = str_index;
 					current->str = NULL;
-
-					// String is no longer needed
-					// Memory Manage
-					free(str);
 				}
 			#else
-				for (int i = 0; i < sizeof(As_LexStrLookup)/sizeof(As_LexStrLookup[0]); i++) {
-					if (*str == *As_LexStrLookup[i] && strcmp(As_LexStrLookup[i], str) == 0) {
+				for (int keyword = 0; keyword < sizeof(As_LexStrLookup)/sizeof(As_LexStrLookup[0]); keyword++) {
+					if (*str == *As_LexStrLookup[keyword] && strcmp(As_LexStrLookup[keyword], str) == 0) {
 						current->type = AS_CFG_TOKEN_KEY;
-						current->value = i;
+						current->value = keyword;
 						current->str = NULL;
 
-						// String is no longer needed
-						// Memory Manage
-						free(str);
-
 						break;
 					}
 				}
@@ -302,6 +461,460 @@ struct AS_CfgTok *cfg_lex(FILE *file) {
         return head;
 }
 
+struct AS_CfgTok *cfg_lex(char *path, struct AS_Arena *arena) {
+	struct stat st;
+	char *data = NULL;
+
+	if (map_file(path, &st, &data) == -1) {
+		return NULL;
+	}
+
+	struct AS_CfgTok *head = lex_buffer(data, st.st_size, arena);
+
+	// Memory Manage
+	if (data != NULL) {
+		munmap(data, st.st_size);
+	}
+
+	return head;
+}
+
+/**
+ * Append bytes onto a config cache being built.
+ *
+ * @param struct AS_CfgCacheBuffer *buffer - The cache.
+ * @param const void *data - The bytes.
+ * @param size_t length - The number of bytes.
+ * */
+static void cache_push(struct AS_CfgCacheBuffer *buffer, const void *data, size_t length) {
+	if (buffer->length + length > buffer->capacity) {
+		buffer->capacity = max(buffer->capacity * 2, (size_t)4096);
+
+		while (buffer->length + length > buffer->capacity) {
+			buffer->capacity *= 2;
+		}
+
+		buffer->data = (char *)realloc(buffer->data, buffer->capacity);
+	}
+
+	memcpy(buffer->data + buffer->length, data, length);
+	buffer->length += length;
+}
+
+/**
+ * The size of an entry in the config cache.
+ *
+ * @param struct AS_CfgCacheEntry *entry - The entry.
+ * @return The number of bytes the entry and everything following it take up.
+ * */
+static size_t entry_size(struct AS_CfgCacheEntry *entry) {
+	return sizeof(struct AS_CfgCacheEntry) + entry->path_length + (size_t)entry->token_count * sizeof(struct AS_CfgCacheToken) +
+	       entry->string_length;
+}
+
+/**
+ * Check that an entry of a config cache is whole, and holds a valid token list.
+ *
+ * @param const char *entry - The start of the entry.
+ * @param size_t length - The number of bytes from entry to the end of the entries.
+ * @return The size of the entry, 0 if it is not valid.
+ * */
+static size_t validate_entry(const char *entry, size_t length) {
+	struct AS_CfgCacheEntry header;
+
+	if (length < sizeof(header)) {
+		return 0;
+	}
+
+	memcpy(&header, entry, sizeof(header));
+
+	size_t size = entry_size(&header);
+
+	if (header.token_count == 0 || size > length) {
+		return 0;
+	}
+
+	const char *tokens = entry + sizeof(header) + header.path_length;
+	const char *strings = tokens + (size_t)header.token_count * sizeof(struct AS_CfgCacheToken);
+
+	if (header.string_length > 0 && strings[header.string_length - 1] != 0) {
+		// A string would run off the end
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < header.token_count; i++) {
+		struct AS_CfgCacheToken token;
+		memcpy(&token, tokens + i * sizeof(token), sizeof(token));
+
+		bool last = (i == header.token_count - 1);
+
+		if (token.type < AS_CFG_TOKEN_EOF || token.type > AS_CFG_TOKEN_SQR || (token.type == AS_CFG_TOKEN_EOF) != last ||
+		    token.str < -1 || token.str >= (int64_t)header.string_length) {
+			return 0;
+		}
+	}
+
+	return size;
+}
+
+/**
+ * Find the entry of a file in a list of config cache entries.
+ *
+ * @param const char *entries - The first entry.
+ * @param uint32_t count - The number of entries.
+ * @param char *path - The path of the file.
+ * @return The entry, NULL if there is none for the file.
+ * */
+static const char *find_entry(const char *entries, uint32_t count, char *path) {
+	size_t length = strlen(path);
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct AS_CfgCacheEntry header;
+		memcpy(&header, entries, sizeof(header));
+
+		if (header.path_length == length && memcmp(entries + sizeof(header), path, length) == 0) {
+			return entries;
+		}
+
+		entries += entry_size(&header);
+	}
+
+	return NULL;
+}
+
+/**
+ * Build the tokens of a config cache entry.
+ *
+ * @param const char *entry - The entry.
+ * @param struct AS_Arena *arena - The arena to allocate the tokens and their strings from.
+ * @return A pointer to the head of a struct AS_CfgTok linked list.
+ * */
+static struct AS_CfgTok *entry_tokens(const char *entry, struct AS_Arena *arena) {
+	struct AS_CfgCacheEntry header;
+	memcpy(&header, entry, sizeof(header));
+
+	const char *tokens = entry + sizeof(header) + header.path_length;
+	char *strings = (char *)arena_alloc(arena, header.string_length);
+
+	memcpy(strings, tokens + (size_t)header.token_count * sizeof(struct AS_CfgCacheToken), header.string_length);
+
+	struct AS_CfgTok *head = NULL;
+	struct AS_CfgTok **link = &head;
+
+	for (uint32_t i = 0; i < header.token_count; i++) {
+		struct AS_CfgCacheToken cached;
+		memcpy(&cached, tokens + i * sizeof(cached), sizeof(cached));
+
+		struct AS_CfgTok *token = new_token(arena);
+
+		token->type = cached.type;
+		token->value = cached.value;
+		token->line = cached.line;
+		token->column = cached.column;
+		token->str = (cached.str >= 0) ? strings + cached.str : NULL;
+
+		*link = token;
+		link = &token->next;
+	}
+
+	return head;
+}
+
+/**
+ * Add the tokens of a file to the cache for the next startup.
+ *
+ * @param char *path - The path of the file.
+ * @param struct stat *st - The status of the file when it was lexed.
+ * @param uint64_t hash - hash_bytes of the file's contents.
+ * @param struct AS_CfgTok *head - The tokens.
+ * */
+static void cache_tokens(char *path, struct stat *st, uint64_t hash, struct AS_CfgTok *head) {
+	struct AS_CfgCacheEntry header = {
+		.mtime_sec = st->st_mtim.tv_sec,
+		.mtime_nsec = st->st_mtim.tv_nsec,
+		.size = st->st_size,
+		.hash = hash,
+		.path_length = strlen(path),
+	};
+
+	struct AS_CfgCacheBuffer strings = { 0 };
+
+	for (struct AS_CfgTok *token = head; token != NULL; token = token->next) {
+		header.token_count++;
+
+		if (token->str != NULL) {
+			cache_push(&strings, token->str, strlen(token->str) + 1);
+		}
+	}
+
+	header.string_length = strings.length;
+
+	cache_push(&next_cache, &header, sizeof(header));
+	cache_push(&next_cache, path, header.path_length);
+
+	int32_t offset = 0;
+
+	for (struct AS_CfgTok *token = head; token != NULL; token = token->next) {
+		struct AS_CfgCacheToken cached = {
+			.type = token->type,
+			.value = token->value,
+			.line = token->line,
+			.column = token->column,
+			.str = (token->str != NULL) ? offset : -1,
+		};
+
+		if (token->str != NULL) {
+			offset += strlen(token->str) + 1;
+		}
+
+		cache_push(&next_cache, &cached, sizeof(cached));
+	}
+
+	if (strings.length > 0) {
+		cache_push(&next_cache, strings.data, strings.length);
+	}
+
+	next_cache.entries++;
+
+	// Memory Manage
+	free(strings.data);
+}
+
+/**
+ * Check if a config cache entry was made from a file as it is now.
+ *
+ * @param struct AS_CfgCacheEntry *header - The entry.
+ * @param struct stat *st - The status of the file.
+ * @return 1 if the file has the same size and modification time.
+ * */
+static bool entry_current(struct AS_CfgCacheEntry *header, struct stat *st) {
+	return header->size == (uint64_t)st->st_size && header->mtime_sec == st->st_mtim.tv_sec && header->mtime_nsec == st->st_mtim.tv_nsec;
+}
+
+struct AS_CfgTok *cfg_tokens(char *path, struct AS_Arena *arena) {
+	if (!caching) {
+		return cfg_lex(path, arena);
+	}
+
+	struct stat st;
+
+	if (stat(path, &st) == -1) {
+		return NULL;
+	}
+
+	struct AS_CfgCacheEntry header;
+
+	// A file read twice already has its entry
+	const char *entry = find_entry(next_cache.data + sizeof(struct AS_CfgCacheHeader), next_cache.entries, path);
+
+	if (entry != NULL) {
+		memcpy(&header, entry, sizeof(header));
+
+		if (entry_current(&header, &st)) {
+			return entry_tokens(entry, arena);
+		}
+	}
+
+	entry = (cache != NULL) ? find_entry(cache + sizeof(struct AS_CfgCacheHeader), ((struct AS_CfgCacheHeader *)cache)->entries, path) : NULL;
+
+	if (entry != NULL) {
+		memcpy(&header, entry, sizeof(header));
+
+		if (entry_current(&header, &st)) {
+			// Unchanged since it was cached, it is not even read
+			cache_push(&next_cache, entry, entry_size(&header));
+			next_cache.entries++;
+
+			return entry_tokens(entry, arena);
+		}
+	}
+
+	char *data = NULL;
+
+	if (map_file(path, &st, &data) == -1) {
+		return NULL;
+	}
+
+	uint64_t hash = hash_bytes(AS_CFG_HASH_SEED, data, st.st_size);
+	struct AS_CfgTok *head = NULL;
+
+	if (entry != NULL && header.size == (uint64_t)st.st_size && header.hash == hash) {
+		// Only the modification time has changed, keep the tokens
+		// under the new time
+		head = entry_tokens(entry, arena);
+	} else {
+		AS_DEBUG_MSG("Lexing %s\n", path);
+		head = lex_buffer(data, st.st_size, arena);
+	}
+
+	cache_tokens(path, &st, hash, head);
+
+	// Memory Manage
+	if (data != NULL) {
+		munmap(data, st.st_size);
+	}
+
+	return head;
+}
+
+/**
+ * Get the path of the config cache.
+ *
+ * @return The path, which the caller must free.
+ * */
+static char *cache_path() {
+	struct passwd *pw = getpwuid(getuid());
+	char *path = (char *)malloc(strlen(pw->pw_dir) + strlen(AS_CFG_CACHE_PATH) + 1);
+
+	strcpy(path, pw->pw_dir);
+	strcat(path, AS_CFG_CACHE_PATH);
+
+	return path;
+}
+
+/**
+ * Hash the keywords of the lexer, in the order of their values.
+ *
+ * Cached keyword tokens only hold the index of their keyword, so a cache
+ * made with keywords which have since been renamed or reordered is stale.
+ *
+ * @return The hash.
+ * */
+static uint64_t keywords_hash() {
+	uint64_t hash = AS_CFG_HASH_SEED;
+
+	for (size_t i = 0; i < sizeof(As_LexStrLookup) / sizeof(As_LexStrLookup[0]); i++) {
+		// The terminators keep the keywords apart, a gap hashes as an empty keyword
+		const char *keyword = (As_LexStrLookup[i] != NULL) ? As_LexStrLookup[i] : "";
+		hash = hash_bytes(hash, keyword, strlen(keyword) + 1);
+	}
+
+	return hash;
+}
+
+/**
+ * Map the config cache, and start reading files through it.
+ *
+ * A cache which is not whole, was made by another version, or was
+ * made with other keywords, is ignored.
+ * */
+static void open_cache() {
+	char *path = cache_path();
+	struct stat st;
+
+	caching = 1;
+	next_cache.length = 0;
+	next_cache.entries = 0;
+
+	struct AS_CfgCacheHeader header = {
+		.magic = AS_CFG_CACHE_MAGIC,
+		.version = AS_CFG_CACHE_VERSION,
+		.keywords = keywords_hash(),
+	};
+
+	// The header of the next cache, its entry count is filled in when it is written
+	cache_push(&next_cache, &header, sizeof(header));
+
+	if (map_file(path, &st, &cache) == -1 || cache == NULL) {
+		free(path);
+
+		return;
+	}
+
+	cache_size = st.st_size;
+	free(path);
+
+	struct AS_CfgCacheHeader found;
+	uint64_t hash = 0;
+	bool valid = cache_size >= sizeof(found) + sizeof(hash);
+
+	if (valid) {
+		memcpy(&found, cache, sizeof(found));
+		memcpy(&hash, cache + cache_size - sizeof(hash), sizeof(hash));
+
+		valid = found.magic == header.magic && found.version == header.version && found.keywords == header.keywords &&
+			hash == hash_bytes(AS_CFG_HASH_SEED, cache, cache_size - sizeof(hash));
+	}
+
+	// Every entry has to be whole
+	size_t offset = sizeof(found);
+	size_t end = cache_size - sizeof(hash);
+
+	for (uint32_t i = 0; valid && i < found.entries; i++) {
+		size_t size = validate_entry(cache + offset, end - offset);
+
+		valid = (size > 0);
+		offset += size;
+	}
+
+	if (!valid || offset != end) {
+		AS_DEBUG_MSG("Ignoring invalid config cache\n");
+
+		munmap(cache, cache_size);
+		cache = NULL;
+		cache_size = 0;
+	}
+}
+
+/**
+ * Stop reading files through the config cache.
+ *
+ * The entries of the files read since open_cache are written as the
+ * new cache, if they differ from the old one.
+ * */
+static void close_cache() {
+	caching = 0;
+
+	memcpy(next_cache.data + offsetof(struct AS_CfgCacheHeader, entries), &next_cache.entries, sizeof(next_cache.entries));
+
+	uint64_t hash = hash_bytes(AS_CFG_HASH_SEED, next_cache.data, next_cache.length);
+	cache_push(&next_cache, &hash, sizeof(hash));
+
+	if (cache == NULL || cache_size != next_cache.length || memcmp(cache, next_cache.data, cache_size) != 0) {
+		// Write the new cache beside the old one, and swap it in
+		char *path = cache_path();
+		char *temporary = (char *)malloc(strlen(path) + strlen(".tmp") + 1);
+
+		strcpy(temporary, path);
+		strcat(temporary, ".tmp");
+
+		// Make sure the directories leading to it exist
+		for (char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+			*slash = 0;
+			mkdir(path, 0755);
+			*slash = '/';
+		}
+
+		int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		ssize_t written = 0;
+
+		if (fd != -1) {
+			written = write(fd, next_cache.data, next_cache.length);
+			close(fd);
+		}
+
+		if (fd == -1 || written != (ssize_t)next_cache.length || rename(temporary, path) == -1) {
+			AS_DEBUG_MSG("Failed to write config cache %s\n", path);
+			unlink(temporary);
+		}
+
+		// Memory Manage
+		free(temporary);
+		free(path);
+	}
+
+	// Memory Manage
+	if (cache != NULL) {
+		munmap(cache, cache_size);
+	}
+
+	cache = NULL;
+	cache_size = 0;
+
+	free(next_cache.data);
+	memset(&next_cache, 0, sizeof(next_cache));
+}
+
 int read_config() {
 	#ifdef AS_GLIB_ENABLE
 		lex_tokens = g_hash_table_new(g_str_hash, g_str_equal);
@@ -318,35 +931,26 @@ int read_config() {
         char *path = (char *)malloc(strlen(pw->pw_dir) + strlen("/.config/assembled/config.cfg") + 1);
         strcpy(path, pw->pw_dir);
         strcpy(path + strlen(pw->pw_dir), "/.config/assembled/config.cfg");
-        
-        FILE *file = fopen(path, "r");
 
-        if (file == NULL) {
+	open_cache();
+
+	struct AS_Arena arena = { 0 };
+        struct AS_CfgTok *head = cfg_tokens(path, &arena);
+
+        if (head == NULL) {
                 printf("Could not open file %s\n", path);
                 AS_DEBUG_MSG("Could not open file %s\n", path);
 
                 exit(1);
         }
 
-        struct AS_CfgTok *head = cfg_lex(file);
-
         interpret_token_stream(head);
 
-        AS_DEBUG_MSG("Token list:\n");
-        struct AS_CfgTok *current = head;
-        while (current != NULL) {
-                AS_DEBUG_MSG("%d { 0x%02X, \"%s\", (%d, %d) } %p\n", current->type, current->value, current->str, current->line, current->column, current->next);
-                struct AS_CfgTok *tmp = current->next;
-
-                free(current);
-
-                current = tmp;
-        }
-        AS_DEBUG_MSG("List end\n");
+	close_cache();
 
         // Memory Manage
+	arena_destroy(&arena);
         free(path);
-        fclose(file);
 
         return 0;
 }
@@ -34,6 +34,8 @@
 #include <editor/keyboard.h>
 #include <editor/config.h>
 
+#include <editor/trace.h>
+
 #include <interface/interface.h>
 
 #include <global.h>
@@ -42,6 +44,8 @@
 /// Maximum number of functions.
 #define MAX_FUNCTION_COUNT 256
 #define PARAM2(a, b) { a, b },
+/// The number of slots the transition table of a keymap starts with.
+#define AS_KEYMAP_MIN_CAPACITY 64
 
 /**
  * A list which represents the order of keys the user needs to press.
@@ -64,6 +68,8 @@ struct AS_KeySeq {
 	struct AS_KeySeqList *list;
 	/// The local function which should be called.
 	int function;
+	/// The index of the screen the sequence belongs to, -1 if it belongs to every screen.
+	int screen;
 	/// Pointer to the next element.
 	struct AS_KeySeq *next;
 };
@@ -76,22 +82,73 @@ static struct AS_KeySeq keyseq_list_head = { 0 };
 static struct AS_KeySeq *keyseq_list_last = &keyseq_list_head;
 
 /**
- * Element on a LIFO stack of the users inputs. */
-struct AS_KeyStackElem {
-	/// The key the user pressed.
-        int key;
-	/// The time the usre pressed the key.
-        time_t time;
+ * A transition of a keymap, from one state to another on a key.
+ * */
+struct AS_KeyTransition {
+	/// The state the transition leaves, -1 if the slot is empty.
+	int state;
+	/// The key which is pressed.
+	int code;
+	/// The state the transition enters.
+	int next;
+};
+
+/**
+ * The key sequences of a screen compiled into a trie.
+ *
+ * Every state is a prefix of at least one sequence, state 0 being the
+ * empty prefix. The edges of the trie are kept in a hash table indexed
+ * by state and keycode, so that every key follows one in O(1).
+ * */
+struct AS_Keymap {
+	/// Open addressed table of transitions.
+	struct AS_KeyTransition *transitions;
+	/// The number of slots in transitions, a power of 2.
+	int capacity;
+	/// The number of transitions.
+	int count;
+	/// The function of every state, -1 if no sequence ends at it.
+	int *functions;
+	/// The number of transitions leaving every state.
+	int *children;
+	/// The number of states.
+	int states;
+	/// The number of states there is room for.
+	int state_capacity;
 };
 
 /**
- * LIFO stack of user's key presses.
+ * The keymap of every screen, compiled the first time the screen gets a key.
  * */
-static struct AS_KeyStackElem key_stack[AS_MAX_KEY_ELEMENTS];
+static struct AS_Keymap *keymaps[AS_MAX_SCREEN_COUNT];
+
 /**
- * Stack pointer of key_stack
+ * Keys which make up a prefix of a sequence, waiting to see if the rest follows.
  * */
-static int key_stack_ptr = 0;
+static int pending[AS_MAX_KEY_ELEMENTS];
+/// The number of keys in pending.
+static int pending_count = 0;
+/// The state of the current keymap which pending leads to.
+static int pending_state = 0;
+/// The number of keys of pending which make up the longest complete sequence, 0 if none do.
+static int accepted = 0;
+/// The function of the longest complete sequence in pending.
+static int accepted_function = -1;
+/// The time (trace_now) at which pending is given up on.
+static uint64_t deadline = 0;
+/// The number of milliseconds to wait for the rest of a sequence.
+static int key_timeout = AS_KEY_TIMEOUT_DEFAULT;
+
+/// Set (1) between AS_KEY_PASTE_BEGIN and AS_KEY_PASTE_END.
+static bool pasting = 0;
+/// The text pasted so far.
+static char *paste = NULL;
+/// The number of characters in paste.
+static size_t paste_length = 0;
+/// The number of bytes allocated for paste.
+static size_t paste_capacity = 0;
+/// Set (1) if the last key pasted was a carriage return.
+static bool paste_return = 0;
 
 /**
  * Arguments for local functions depending on action type.
@@ -117,76 +174,384 @@ static const int func_args[MAX_FUNCTION_COUNT][2] = {
 	[AS_CFG_LOOKUP_MOVE_LN_DOWN]  = PARAM2(LOCAL_BUFFER_MOVE_LINE, 0)
 	[AS_CFG_LOOKUP_COLDESC_LEFT]  = PARAM2(LOCAL_COLDESC_SWITCH, -1)
 	[AS_CFG_LOOKUP_COLDESC_RIGHT] = PARAM2(LOCAL_COLDESC_SWITCH, 1)
+	[AS_CFG_LOOKUP_PAGE_UP]       = PARAM2(LOCAL_PAGE_MOVE, -1)
+	[AS_CFG_LOOKUP_PAGE_DOWN]     = PARAM2(LOCAL_PAGE_MOVE, 1)
+	[AS_CFG_LOOKUP_GOTO_LINE]     = PARAM2(LOCAL_GOTO_LINE, 0)
+	[AS_CFG_LOOKUP_GOTO_SELECTION] = PARAM2(LOCAL_GOTO_SELECTION, 0)
+	[AS_CFG_LOOKUP_UNDO]          = PARAM2(LOCAL_UNDO, 0)
+	[AS_CFG_LOOKUP_REDO]          = PARAM2(LOCAL_UNDO, 1)
+	[AS_CFG_LOOKUP_PROFILER]      = PARAM2(LOCAL_PROFILER, 0)
 };
 
 /**
- * Collapse or interpret the current key stack.
+ * Find the transition of a keymap from a state on a key.
+ *
+ * @param struct AS_Keymap *map - The keymap.
+ * @param int state - The state.
+ * @param int code - The key.
+ * @return The slot of the transition, or of the empty slot where it would go.
+ * */
+static struct AS_KeyTransition *keymap_slot(struct AS_Keymap *map, int state, int code) {
+	uint32_t hash = ((uint32_t)state * 0x9E3779B1) ^ ((uint32_t)code * 0x85EBCA6B);
+	int i = (hash ^ (hash >> 16)) & (map->capacity - 1);
+
+	while (map->transitions[i].state != -1 && (map->transitions[i].state != state || map->transitions[i].code != code)) {
+		i = (i + 1) & (map->capacity - 1);
+	}
+
+	return &map->transitions[i];
+}
+
+/**
+ * Resize the transition table of a keymap.
  *
- * This function looks from the current key_stack_ptr to 0 seeing if it can
- * detect an AS_KeySeq within it. If it can, the stack pointer is set to 0,
- * and the active screen's local function is called. In the event that it
- * detects the beginnings of a key sequence (that is not yet complete), it
- * will return, leaving the stack pointer intact. Otherwise, it will default
- * to calling LOCAL_BUFFER_CHAR with the character at the stack pointer. */
-void collapse_stack() {
-	struct AS_KeySeq *current = &keyseq_list_head;
+ * @param struct AS_Keymap *map - The keymap.
+ * @param int capacity - The new number of slots, a power of 2.
+ * */
+static void keymap_resize(struct AS_Keymap *map, int capacity) {
+	struct AS_KeyTransition *old = map->transitions;
+	int old_capacity = map->capacity;
 
-	while (current != NULL) {
-		struct AS_KeySeqList *element = current->list;
-		int i = 0;
-		
-		for (; i < key_stack_ptr; i++) {
-			if (element == NULL || key_stack[i].key != element->code) {
-				break;
-			}
+	map->transitions = (struct AS_KeyTransition *)malloc(capacity * sizeof(struct AS_KeyTransition));
+	map->capacity = capacity;
 
-			element = element->next;
+	for (int i = 0; i < capacity; i++) {
+		map->transitions[i].state = -1;
+	}
+
+	for (int i = 0; i < old_capacity; i++) {
+		if (old[i].state != -1) {
+			*keymap_slot(map, old[i].state, old[i].code) = old[i];
 		}
+	}
+
+	// Memory Manage
+	free(old);
+}
+
+/**
+ * Add a state to a keymap.
+ *
+ * @param struct AS_Keymap *map - The keymap.
+ * @return The new state.
+ * */
+static int keymap_new_state(struct AS_Keymap *map) {
+	if (map->states >= map->state_capacity) {
+		map->state_capacity = max(map->state_capacity * 2, 16);
+		map->functions = (int *)realloc(map->functions, map->state_capacity * sizeof(int));
+		map->children = (int *)realloc(map->children, map->state_capacity * sizeof(int));
+	}
 
-		if (i == key_stack_ptr && element == NULL) {
-			// Found function
-			AS_DEBUG_MSG("Calling function %d\n", current->function);
-			as_ctx.screen->local(func_args[current->function][0], func_args[current->function][1]);
+	map->functions[map->states] = -1;
+	map->children[map->states] = 0;
 
-			key_stack_ptr = 0;
+	return map->states++;
+}
+
+/**
+ * Add a key sequence to a keymap.
+ *
+ * If the sequence is already in the keymap, the function it was added
+ * with is kept.
+ *
+ * @param struct AS_Keymap *map - The keymap.
+ * @param struct AS_KeySeq *sequence - The sequence.
+ * */
+static void keymap_add(struct AS_Keymap *map, struct AS_KeySeq *sequence) {
+	int state = 0;
+	int length = 0;
+
+	for (struct AS_KeySeqList *element = sequence->list; element != NULL; element = element->next) {
+		if (++length > AS_MAX_KEY_ELEMENTS) {
+			AS_DEBUG_MSG("Key sequence of function %d is longer than %d keys, ignoring it\n", sequence->function, AS_MAX_KEY_ELEMENTS);
 
 			return;
-		} else if (i > 0) {
+		}
+	}
+
+	for (struct AS_KeySeqList *element = sequence->list; element != NULL; element = element->next) {
+		// Keep the table at most half full
+		if ((map->count + 1) * 2 > map->capacity) {
+			keymap_resize(map, map->capacity * 2);
+		}
+
+		struct AS_KeyTransition *slot = keymap_slot(map, state, element->code);
+
+		if (slot->state == -1) {
+			// New prefix
+			*slot = (struct AS_KeyTransition){ .state = state, .code = element->code, .next = keymap_new_state(map) };
+			map->count++;
+			map->children[state]++;
+		}
+
+		state = slot->next;
+	}
+
+	if (state != 0 && map->functions[state] == -1) {
+		map->functions[state] = sequence->function;
+	}
+}
+
+/**
+ * Compile the keymap of a screen.
+ *
+ * Sequences defined for the screen take precedence over those defined
+ * for every screen.
+ *
+ * @param int screen - The index of the screen.
+ * @return The keymap.
+ * */
+static struct AS_Keymap *compile_keymap(int screen) {
+	struct AS_Keymap *map = (struct AS_Keymap *)calloc(1, sizeof(struct AS_Keymap));
+
+	keymap_resize(map, AS_KEYMAP_MIN_CAPACITY);
+	keymap_new_state(map);
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (struct AS_KeySeq *current = &keyseq_list_head; current != NULL; current = current->next) {
+			if (current->list != NULL && current->screen == ((pass == 0) ? screen : -1)) {
+				keymap_add(map, current);
+			}
+		}
+	}
+
+	AS_DEBUG_MSG("Compiled keymap of screen %d, %d states, %d transitions\n", screen, map->states, map->count);
+
+	return map;
+}
+
+/**
+ * Get the keymap of the active screen, compiling it if needed.
+ *
+ * @return The keymap.
+ * */
+static struct AS_Keymap *current_keymap() {
+	int screen = (int)(as_ctx.screen - as_ctx.screens);
+
+	if (keymaps[screen] == NULL) {
+		keymaps[screen] = compile_keymap(screen);
+	}
+
+	return keymaps[screen];
+}
+
+/**
+ * Call the active screen's local function for a key sequence's function.
+ *
+ * @param int function - The function (AS_KeySeq.function).
+ * */
+static void call_function(int function) {
+	AS_DEBUG_MSG("Calling function %d\n", function);
+	as_ctx.screen->local(func_args[function][0], func_args[function][1]);
+}
+
+/**
+ * Insert a key as a character.
+ *
+ * @param int c - The key.
+ * */
+static void put_key(int c) {
+	AS_DEBUG_MSG("Putting key %d\n", c);
+	as_ctx.screen->local(LOCAL_BUFFER_CHAR, c);
+}
+
+static void feed_key(int c);
+
+/**
+ * Stop waiting for the rest of a sequence.
+ *
+ * The longest complete sequence among the pending keys is called, or if
+ * there is none, the first pending key is inserted as a character. The
+ * keys after it are fed again, they may start another sequence.
+ * */
+static void resolve_pending() {
+	int keys[AS_MAX_KEY_ELEMENTS];
+	int count = pending_count;
+	int used = accepted;
+	int function = accepted_function;
+
+	memcpy(keys, pending, count * sizeof(int));
+
+	pending_count = 0;
+	pending_state = 0;
+	accepted = 0;
+	accepted_function = -1;
+
+	if (used > 0) {
+		call_function(function);
+	} else {
+		put_key(keys[0]);
+		used = 1;
+	}
+
+	for (int i = used; i < count; i++) {
+		feed_key(keys[i]);
+	}
+}
+
+/**
+ * Advance the active screen's keymap by a key.
+ *
+ * @param int c - The key.
+ * */
+static void feed_key(int c) {
+	struct AS_Keymap *map = current_keymap();
+	struct AS_KeyTransition *slot = keymap_slot(map, pending_state, c);
+
+	if (slot->state == -1) {
+		// No sequence continues with this key
+		if (pending_count == 0) {
+			put_key(c);
+
 			return;
 		}
 
-		current = current->next;
+		resolve_pending();
+		feed_key(c);
+
+		return;
 	}
 
-	AS_DEBUG_MSG("Putting key %d\n", key_stack[key_stack_ptr - 1].key);
-	as_ctx.screen->local(LOCAL_BUFFER_CHAR, key_stack[--key_stack_ptr].key);
-	key_stack_ptr = 0;
+	pending[pending_count++] = c;
+	pending_state = slot->next;
+
+	if (map->functions[pending_state] != -1) {
+		accepted = pending_count;
+		accepted_function = map->functions[pending_state];
+	}
+
+	if (map->children[pending_state] == 0) {
+		// Nothing longer can match
+		resolve_pending();
+
+		return;
+	}
+
+	// Wait for the rest of the sequence
+	deadline = trace_clock() + (uint64_t)key_timeout * 1000000;
 }
 
-// CONVIENENCE: Create an End of Command char
-//              that will tell us when to
-//              collapse the stack
-void key(int c) {
-        // Wrap around (should never happen unless user has more
-        //              keys than MAX_KEY_ELEMENTS)
-        if (key_stack_ptr >= AS_MAX_KEY_ELEMENTS) {
-                key_stack_ptr = 0;
-        }
+/**
+ * Add a key to the text being pasted.
+ *
+ * Line endings are turned into '\\n', keys which are not characters
+ * are dropped.
+ *
+ * @param int c - The key.
+ * */
+static void paste_key(int c) {
+	bool newline = (c == '\n' && paste_return);
+
+	paste_return = (c == '\r');
 
+	if (c < 0 || c > 255 || newline) {
+		// The newline of a "\\r\\n" was already added
+		return;
+	}
+
+	if (paste_length + 1 > paste_capacity) {
+		paste_capacity = max(paste_capacity * 2, (size_t)4096);
+		paste = (char *)realloc(paste, paste_capacity);
+	}
+
+	paste[paste_length++] = (c == '\r') ? '\n' : c;
+}
+
+void key(int c) {
 	AS_DEBUG_MSG("Key pressed: %d\n", c);
 
-        // Push new value to stack
-        key_stack[key_stack_ptr].key = c;
-        key_stack[key_stack_ptr++].time = time(NULL);
-        
-        // Try to collapse the stack
-        collapse_stack();
+	if (pasting) {
+		if (c != AS_KEY_PASTE_END) {
+			paste_key(c);
+
+			return;
+		}
+
+		pasting = 0;
+
+		if (!(as_ctx.screen->render_options & SCR_OPT_PASTE)) {
+			// The screen only takes keys, as if the text were typed
+			for (size_t i = 0; i < paste_length; i++) {
+				feed_key((unsigned char)paste[i]);
+			}
+
+			return;
+		}
+
+		// Hand the whole text to the screen at once
+		as_ctx.paste = paste;
+		as_ctx.paste_length = paste_length;
+		as_ctx.screen->local(LOCAL_BUFFER_PASTE, 0);
+
+		return;
+	}
+
+	if (c == AS_KEY_PASTE_BEGIN) {
+		if (pending_count > 0) {
+			resolve_pending();
+		}
+
+		pasting = 1;
+		paste_length = 0;
+		paste_return = 0;
+
+		return;
+	}
+
+	feed_key(c);
+}
+
+int keyboard_timeout() {
+	if (pending_count == 0) {
+		return -1;
+	}
+
+	uint64_t now = trace_clock();
+
+	// Round up, so the deadline has passed when woken
+	return (now >= deadline) ? 0 : (int)((deadline - now + 999999) / 1000000);
+}
+
+bool keyboard_tick() {
+	if (pending_count == 0 || trace_clock() < deadline) {
+		return 0;
+	}
+
+	resolve_pending();
+
+	return 1;
 }
 
 // Initialize the keyboard handler, import
 // key combbinations from the configuration
 // file into a data structure.
 struct AS_CfgTok *configure_keyboard(struct AS_CfgTok *token) {
+	// keyboard keyseq <function> : <key>, <key>, ...
+	// keyboard <screen> keyseq <function> : <key>, <key>, ...
+	// keyboard timeout : <milliseconds>
+	if (token->type == AS_CFG_TOKEN_KEY && token->value == AS_CFG_LOOKUP_TIMEOUT) {
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_COL, "Expected colon")
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_INT, "Expected integer")
+
+		key_timeout = max(token->value, 0);
+
+		AS_NEXT_TOKEN
+
+		return token;
+	}
+
+	int screen = -1;
+
+	if (token->type == AS_CFG_TOKEN_STR || (token->type == AS_CFG_TOKEN_KEY && token->value != AS_CFG_LOOKUP_KEYSEQ)) {
+		// The sequence only belongs to the named screen
+		char *name = (token->type == AS_CFG_TOKEN_STR) ? token->str : (char *)As_LexStrLookup[token->value];
+		screen = GET_SCR_IDX(name);
+
+		AS_NEXT_TOKEN
+	}
+
         AS_EXPECT_TOKEN(AS_CFG_TOKEN_KEY, "Expected keyword")
         AS_EXPECT_VALUE(AS_CFG_LOOKUP_KEYSEQ, "Expected keyword keyseq")
 
@@ -228,7 +593,8 @@ struct AS_CfgTok *configure_keyboard(struct AS_CfgTok *token) {
 
 	keyseq_list_last->list = list;
 	keyseq_list_last->function = function;
-	keyseq_list_last->next = (struct AS_KeySeq *)malloc(sizeof(struct AS_KeySeq));
+	keyseq_list_last->screen = screen;
+	keyseq_list_last->next = (struct AS_KeySeq *)calloc(1, sizeof(struct AS_KeySeq));
 	keyseq_list_last = keyseq_list_last->next;
 
         AS_DEBUG_MSG("Stack end\n")
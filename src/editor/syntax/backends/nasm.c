@@ -37,11 +37,14 @@
 #include <global.h>
 #include <string.h>
 
-#ifdef AS_GLIB_ENABLE
-	#include <glib-2.0/glib.h>
-	static GHashTable *keywords_hash; /// If AS_GLIB_ENABLE is defined, this is used.
-#endif
-
+/// Words longer than this are never keywords.
+#define AS_ASM_MAX_KEYWORD_LENGTH 32
+/// The number of slots in the keyword hash table (must be a power of 2 larger than the number of keywords).
+#define AS_ASM_HASH_SIZE 2048
+/// The number of buckets keywords are grouped into before being placed in the hash table.
+#define AS_ASM_HASH_BUCKETS 512
+/// The largest displacement tried for a bucket.
+#define AS_ASM_MAX_DISPLACEMENT (1 << 20)
 
 /**
  * A structure which defines a keyword and its color.
@@ -1422,28 +1425,187 @@ static struct AS_Keyword keywords[] = {
 	{ "VSCATTERPF1QPS", INSTRUCTION },
 };
 
+/// The number of entries in keywords.
+#define AS_ASM_KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+/// Index + 1 of the keyword in each slot of the hash table, 0 if the slot is empty.
+static uint16_t keyword_slots[AS_ASM_HASH_SIZE];
+/// The seed used to hash the keywords of each bucket into keyword_slots.
+static uint32_t keyword_displacements[AS_ASM_HASH_BUCKETS];
+/// The number of keywords in each bucket, only used while building the table.
+static int bucket_sizes[AS_ASM_HASH_BUCKETS];
+
+/**
+ * Hash a word, ignoring case.
+ *
+ * @param uint32_t seed - Selects the hash function.
+ * @param const char *word - The word to hash (not necessarily zero terminated).
+ * @param int length - The number of characters in word.
+ * @return The hash of the word.
+ * */
+static uint32_t keyword_hash(uint32_t seed, const char *word, int length) {
+	// FNV-1a, followed by a finalizer so that every seed
+	// spreads the words differently
+	uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+
+	for (int i = 0; i < length; i++) {
+		hash ^= (uint8_t)toupper(word[i]);
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+
+	return hash;
+}
+
+/**
+ * Find the color of a keyword.
+ *
+ * @param const char *word - The word to look up, in any case (not necessarily zero terminated).
+ * @param int length - The number of characters in word.
+ * @return The color pair index of the keyword, 0 if word is not a keyword.
+ * */
+static int keyword_color(const char *word, int length) {
+	uint32_t bucket = keyword_hash(0, word, length) % AS_ASM_HASH_BUCKETS;
+	uint32_t slot = keyword_hash(keyword_displacements[bucket], word, length) & (AS_ASM_HASH_SIZE - 1);
+
+	if (keyword_slots[slot] == 0) {
+		return 0;
+	}
+
+	// The slot may hold a different keyword, compare them
+	struct AS_Keyword *keyword = &keywords[keyword_slots[slot] - 1];
+
+	for (int i = 0; i < length; i++) {
+		if (keyword->word[i] != toupper(word[i])) {
+			return 0;
+		}
+	}
+
+	if (keyword->word[length] != 0) {
+		return 0;
+	}
+
+	return keyword->color;
+}
+
+/**
+ * Compare the sizes of two buckets, for sorting them largest first.
+ * */
+static int compare_buckets(const void *a, const void *b) {
+	return bucket_sizes[*(const int *)b] - bucket_sizes[*(const int *)a];
+}
+
+/**
+ * Build the keyword hash table.
+ *
+ * Keywords are grouped into buckets by one hash, then, largest bucket
+ * first, each bucket is given the first displacement (seed of a second
+ * hash) which places all of its keywords into empty slots. Lookups hash
+ * the word twice and compare it against a single keyword.
+ * */
+static void build_keyword_hash() {
+	static int bucket_next[AS_ASM_KEYWORD_COUNT];
+	int bucket_heads[AS_ASM_HASH_BUCKETS];
+	int order[AS_ASM_HASH_BUCKETS];
+
+	memset(keyword_slots, 0, sizeof(keyword_slots));
+	memset(bucket_sizes, 0, sizeof(bucket_sizes));
+
+	for (int i = 0; i < AS_ASM_HASH_BUCKETS; i++) {
+		bucket_heads[i] = -1;
+		order[i] = i;
+	}
+
+	// Group the keywords into buckets
+	for (int i = 0; i < AS_ASM_KEYWORD_COUNT; i++) {
+		uint32_t bucket = keyword_hash(0, keywords[i].word, strlen(keywords[i].word)) % AS_ASM_HASH_BUCKETS;
+		bool duplicate = 0;
+
+		for (int j = bucket_heads[bucket]; j != -1; j = bucket_next[j]) {
+			if (strcmp(keywords[i].word, keywords[j].word) == 0) {
+				duplicate = 1;
+				break;
+			}
+		}
+
+		// The keywords list repeats some instructions, only
+		// the first is kept
+		if (duplicate) {
+			continue;
+		}
+
+		bucket_next[i] = bucket_heads[bucket];
+		bucket_heads[bucket] = i;
+		bucket_sizes[bucket]++;
+	}
+
+	qsort(order, AS_ASM_HASH_BUCKETS, sizeof(int), compare_buckets);
+
+	// Find a displacement for each bucket
+	for (int i = 0; i < AS_ASM_HASH_BUCKETS && bucket_sizes[order[i]] > 0; i++) {
+		int bucket = order[i];
+		uint32_t displacement = 1;
+
+		for (; displacement < AS_ASM_MAX_DISPLACEMENT; displacement++) {
+			int placed = bucket_heads[bucket];
+
+			for (; placed != -1; placed = bucket_next[placed]) {
+				uint32_t slot = keyword_hash(displacement, keywords[placed].word, strlen(keywords[placed].word)) & (AS_ASM_HASH_SIZE - 1);
+
+				if (keyword_slots[slot] != 0) {
+					break;
+				}
+
+				keyword_slots[slot] = placed + 1;
+			}
+
+			if (placed == -1) {
+				// Every keyword in the bucket was placed
+				break;
+			}
+
+			// Collision, take back the keywords placed with this
+			// displacement
+			for (int j = bucket_heads[bucket]; j != placed; j = bucket_next[j]) {
+				keyword_slots[keyword_hash(displacement, keywords[j].word, strlen(keywords[j].word)) & (AS_ASM_HASH_SIZE - 1)] = 0;
+			}
+		}
+
+		if (displacement == AS_ASM_MAX_DISPLACEMENT) {
+			AS_DEBUG_MSG("Failed to place NASM keyword bucket %d, its keywords will not be highlighted\n", bucket);
+		}
+
+		keyword_displacements[bucket] = displacement;
+	}
+}
+
 /**
  * Internal function to parse an unwrapped line into syntax point
  *
- * @param char *line - The unwrapped line to be decoded into a series of syntax points.
- * @return A pointer to the head of a AS_SyntaxPoint list, its memory is owned by the caller.
+ * @param char *line - The unwrapped line to be decoded into a series of syntax points (not necessarily zero terminated).
+ * @param int length - The number of characters in line.
+ * @param struct AS_SyntaxPoint *points - The array to write the points into, must have room for `length` points.
+ * @return The number of points written.
  * */
-struct AS_SyntaxPoint *as_asm_get_syntax(char *line) {
+int as_asm_get_syntax(char *line, int length, struct AS_SyntaxPoint *points) {
 	if (line == NULL) {
-		return NULL;
+		return 0;
 	}
 
 	char c = 0;
 	int x = 0;
+	int count = 0;
 
-	int org_len = strlen(line);
+	int org_len = length;
 
-	struct AS_SyntaxPoint *head = (struct AS_SyntaxPoint *)malloc(sizeof(struct AS_SyntaxPoint));
-	memset(head, 0, sizeof(struct AS_SyntaxPoint));
-	struct AS_SyntaxPoint *current = head;
-	struct AS_SyntaxPoint *prev = NULL;
+	while (x < org_len && (c = *line)) {
+		struct AS_SyntaxPoint *current = &points[count];
+		struct AS_SyntaxPoint *prev = (count > 0) ? &points[count - 1] : NULL;
 
-	while ((c = *line) && x <= org_len) {
+		current->color = 0;
 		current->length = 1;
 
 		switch (c) {
@@ -1480,9 +1642,9 @@ struct AS_SyntaxPoint *as_asm_get_syntax(char *line) {
 		case ';': {
 			current->color = COMMENT;
 			current->x = x;
-			current->length = strlen(line);
+			current->length = org_len - x;
 
-			goto finish;
+			return count + 1;
 		}
 
 		default: {
@@ -1498,35 +1660,15 @@ struct AS_SyntaxPoint *as_asm_get_syntax(char *line) {
 
 			while (isalnum(n) || n == '_') {
 				i++;
-				n = *(line + i);
-			}
-
-			char *extracted = (char *)malloc(i);
-			strncpy(extracted, start, i);
-			extracted[i] = 0;
-
-			// Convert to uppercase
-			for (int j = 0; j < i; j++) {
-				extracted[j] = toupper(extracted[j]);
+				n = (x + i < org_len) ? *(line + i) : 0;
 			}
 
 			current->length = i;
 
-			// Lookup the color
-			#ifdef AS_GLIB_ENABLE
-				struct AS_Keyword *keyword = g_hash_table_lookup(keywords_hash, (gpointer)extracted);
-
-				if (keyword != NULL) {
-					current->color = keyword->color;
-				}
-			#else
-				for (int j = 0; j < (sizeof(keywords)/sizeof(keywords[0])); j++) {
-					if (*extracted == *keywords[j].word && strcmp(extracted, keywords[j].word) == 0) {
-						current->color = keywords[j].color;
-						break;
-					}
-				}
-			#endif
+			// Longer words can not be keywords
+			if (i <= AS_ASM_MAX_KEYWORD_LENGTH) {
+				current->color = keyword_color(start, i);
+			}
 
 			// Check if string is apart of macro
 			if (prev != NULL && prev->color == MACRO) {
@@ -1536,39 +1678,23 @@ struct AS_SyntaxPoint *as_asm_get_syntax(char *line) {
 			// Advance
 			line += i - 1;
 
-			// Memory Manage
-			free(extracted);
-
 			break;
 		}
 		}
 
-		// Set properties of current link
+		// Set properties of current point
 		current->x = x;
 		x += current->length;
 		// Advance
-		current->next = (struct AS_SyntaxPoint *)malloc(sizeof(struct AS_SyntaxPoint));
-		memset(current->next, 0, sizeof(struct AS_SyntaxPoint));
-		prev = current;
-		current = current->next;
-
-skip:
+		count++;
 		line++;
 	}
 
-finish:
-
-	return head;
+	return count;
 }
 
 void as_asm_backend_init(int i) {
-	#ifdef AS_GLIB_ENABLE
-		keywords_hash = g_hash_table_new(g_str_hash, g_str_equal);
-
-		for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-			g_hash_table_insert(keywords_hash, (gpointer)keywords[i].word, (gpointer)&keywords[i]);
-		}
-	#endif
+	build_keyword_hash();
 
 	as_ctx.syn_backends[i].extensions[0] = AS_SYNTAX_TYPE_ASM;
 	as_ctx.syn_backends[i].get_syntax = as_asm_get_syntax;
@@ -34,39 +34,108 @@
 #include <editor/syntax/backends/nasm.h>
 
 #include <string.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <includes.h>
 #include <global.h>
+#include <util.h>
+
+/**
+ * A request to highlight a line, and once the worker is
+ * done with it, its result.
+ * */
+struct AS_SyntaxJob {
+	/// The line being highlighted, only touched by the UI thread.
+	struct AS_LLElement *element;
+	/// The file the line belongs to, only touched by the UI thread.
+	struct AS_TextFile *file;
+	/// The function used to highlight the line.
+	int (*get_syntax)(char *, int, struct AS_SyntaxPoint *);
+	/// The version of the line the job was made from.
+	uint32_t version;
+	/// The number of characters in text.
+	int length;
+	/// The number of points in points, set by the worker.
+	int count;
+	/// Room for a point per character of text.
+	struct AS_SyntaxPoint *points;
+	/// A copy of the line's contents.
+	char *text;
+	/// The next job in the list.
+	struct AS_SyntaxJob *next;
+};
 
 static int backend_count = 0;
 
+/// The syntax worker thread.
+static pthread_t worker;
+/// Protects everything below.
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+/// Signaled when a job is queued, or the worker should stop.
+static pthread_cond_t worker_wake = PTHREAD_COND_INITIALIZER;
+/// Set (1) when the worker should stop.
+static bool worker_stop = 0;
+/// Jobs waiting for the worker, oldest first.
+static struct AS_SyntaxJob *pending_head = NULL;
+/// The newest job waiting for the worker.
+static struct AS_SyntaxJob *pending_tail = NULL;
+/// Jobs the worker has finished, waiting to be applied.
+static struct AS_SyntaxJob *completed = NULL;
+/// Readable while there are completed jobs.
+static int worker_fd = -1;
+
+static void *syntax_worker(void *argument);
+
 void init_syntax() {
 	as_asm_backend_init(backend_count++);
+
+	worker_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	pthread_create(&worker, NULL, syntax_worker, NULL);
 }
 
-struct AS_SyntaxPoint *get_syntax(struct AS_TextFile *file, struct AS_LLElement *element) {
-	// Find the index of the first '.' from the end of the file name
-	int dot;
-	for (dot = strlen(file->name) - 1; dot >= 0; dot--) {
-		if (file->name[dot] == '.') {
-			dot++;
-			break;
+void stop_syntax() {
+	pthread_mutex_lock(&worker_lock);
+	worker_stop = 1;
+	pthread_cond_signal(&worker_wake);
+	pthread_mutex_unlock(&worker_lock);
+
+	pthread_join(worker, NULL);
+
+	// Throw away outstanding jobs
+	struct AS_SyntaxJob *lists[] = { pending_head, completed };
+
+	for (int i = 0; i < 2; i++) {
+		while (lists[i] != NULL) {
+			struct AS_SyntaxJob *next = lists[i]->next;
+			free(lists[i]);
+			lists[i] = next;
 		}
 	}
 
-	// Copy out the extension
-	char *extension = (char *)malloc(strlen(file->name) - dot);
-	strcpy(extension, file->name + dot);
+	pending_head = pending_tail = completed = NULL;
+	close(worker_fd);
+}
+
+struct AS_SyntaxBackendMeta *find_syntax_backend(char *name) {
+	// Find the extension, after the last '.' in the file name
+	char *extension = strrchr(name, '.');
+
+	if (extension == NULL) {
+		return NULL;
+	}
+
+	extension++;
 
 	// TODO: This can be further optimized, structures need to be changed.
 
 	// Look at each backend's supported extensions list
 	for (int i = 0; i < backend_count; i++) {
-		for (int j = 0; j < AS_MAX_BACKENDS; j++) {
+		for (int j = 0; j < AS_MAX_BACKEND_EXTS; j++) {
 			const char *string = As_SyntaxExtNames[as_ctx.syn_backends[i].extensions[j]];
 
 			if (*string == *extension && strcmp(string, extension) == 0) {
-				// Extensions match, get syntax
-				return as_ctx.syn_backends[i].get_syntax(element->contents);
+				// Extensions match
+				return &as_ctx.syn_backends[i];
 			}
 		}
 	}
@@ -74,3 +143,212 @@ struct AS_SyntaxPoint *get_syntax(struct AS_TextFile *file, struct AS_LLElement
 	// Extension didn't match any backend, no syntax
 	return NULL;
 }
+
+/**
+ * Pack syntax points.
+ *
+ * Drops uncolored points, and merges adjacent points of the
+ * same color.
+ *
+ * @param struct AS_SyntaxPoint *points - The points to pack, in place.
+ * @param int count - The number of points.
+ * @return The number of points left.
+ * */
+static int pack_syntax(struct AS_SyntaxPoint *points, int count) {
+	int packed = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (points[i].color == 0) {
+			continue;
+		}
+
+		if (packed > 0 && points[packed - 1].color == points[i].color
+		    && points[packed - 1].x + points[packed - 1].length == points[i].x) {
+			points[packed - 1].length += points[i].length;
+
+			continue;
+		}
+
+		points[packed++] = points[i];
+	}
+
+	return packed;
+}
+
+/**
+ * Store syntax points in a line.
+ *
+ * The points are copied into the line's current array if they
+ * fit, otherwise a new array is allocated from the file's arena.
+ *
+ * @param struct AS_TextFile *file - The file the line belongs to.
+ * @param struct AS_LLElement *element - The line to store the points in.
+ * @param struct AS_SyntaxPoint *points - The points to store.
+ * @param int count - The number of points.
+ * */
+static void store_syntax(struct AS_TextFile *file, struct AS_LLElement *element, struct AS_SyntaxPoint *points, int count) {
+	if (count > element->syntax_capacity) {
+		// Does not fit into the line's current array, its
+		// old array is abandoned until the arena is reset
+		file->syntax_waste += element->syntax_capacity * sizeof(struct AS_SyntaxPoint);
+
+		element->syntax = (struct AS_SyntaxPoint *)arena_alloc(&file->syntax_arena, count * sizeof(struct AS_SyntaxPoint));
+		element->syntax_capacity = count;
+	}
+
+	if (count > 0) {
+		memcpy(element->syntax, points, count * sizeof(struct AS_SyntaxPoint));
+	}
+
+	element->syntax_count = count;
+}
+
+/**
+ * The syntax worker thread.
+ *
+ * Highlights queued jobs one at a time, and moves them to the
+ * completed list.
+ * */
+static void *syntax_worker(void *argument) {
+	pthread_mutex_lock(&worker_lock);
+
+	while (1) {
+		while (worker_stop == 0 && pending_head == NULL) {
+			pthread_cond_wait(&worker_wake, &worker_lock);
+		}
+
+		if (worker_stop) {
+			break;
+		}
+
+		struct AS_SyntaxJob *job = pending_head;
+		pending_head = job->next;
+
+		if (pending_head == NULL) {
+			pending_tail = NULL;
+		}
+
+		// Highlight without holding the lock
+		pthread_mutex_unlock(&worker_lock);
+
+		job->count = pack_syntax(job->points, job->get_syntax(job->text, job->length, job->points));
+
+		pthread_mutex_lock(&worker_lock);
+
+		job->next = completed;
+		completed = job;
+
+		// Wake up whoever is waiting on worker_fd
+		uint64_t one = 1;
+		write(worker_fd, &one, sizeof(one));
+	}
+
+	pthread_mutex_unlock(&worker_lock);
+
+	return NULL;
+}
+
+void request_syntax(struct AS_TextFile *file, struct AS_LLElement *element) {
+	element->dirty = 0;
+
+	if (file->syntax_backend == NULL || element->length == 0) {
+		// Nothing to highlight
+		element->syntax_count = 0;
+
+		return;
+	}
+
+	// Copy the line, so that it can be edited while the worker
+	// is highlighting it
+	struct AS_SyntaxJob *job = (struct AS_SyntaxJob *)malloc(sizeof(struct AS_SyntaxJob) + element->length * (sizeof(struct AS_SyntaxPoint) + 1));
+
+	job->element = element;
+	job->file = file;
+	job->get_syntax = file->syntax_backend->get_syntax;
+	job->version = element->version;
+	job->length = element->length;
+	job->count = 0;
+	job->points = (struct AS_SyntaxPoint *)(job + 1);
+	job->text = (char *)(job->points + element->length);
+	job->next = NULL;
+
+	memcpy(job->text, element->contents, element->length);
+
+	element->syntax_jobs++;
+
+	pthread_mutex_lock(&worker_lock);
+
+	if (pending_tail == NULL) {
+		pending_head = job;
+	} else {
+		pending_tail->next = job;
+	}
+
+	pending_tail = job;
+
+	pthread_cond_signal(&worker_wake);
+	pthread_mutex_unlock(&worker_lock);
+}
+
+bool apply_syntax() {
+	pthread_mutex_lock(&worker_lock);
+
+	struct AS_SyntaxJob *job = completed;
+	completed = NULL;
+
+	// Everything completed is being applied
+	uint64_t count = 0;
+	read(worker_fd, &count, sizeof(count));
+
+	pthread_mutex_unlock(&worker_lock);
+
+	bool applied = 0;
+
+	while (job != NULL) {
+		struct AS_SyntaxJob *next = job->next;
+		struct AS_LLElement *element = job->element;
+
+		element->syntax_jobs--;
+
+		if (element->orphaned) {
+			// The line was freed while it was being highlighted
+			if (element->syntax_jobs == 0) {
+				free(element);
+			}
+		} else if (element->version == job->version) {
+			// Results for older versions of the line are dropped,
+			// a job for its current version has been requested
+			store_syntax(job->file, element, job->points, job->count);
+			applied = 1;
+		}
+
+		free(job);
+		job = next;
+	}
+
+	return applied;
+}
+
+int syntax_fd() {
+	return worker_fd;
+}
+
+void collect_syntax(struct AS_TextFile *file) {
+	if (file->syntax_arena.size <= AS_ARENA_CHUNK_SIZE || file->syntax_waste < file->syntax_arena.size / 2) {
+		// Not worth it
+		return;
+	}
+
+	// Forget every line's points
+	for (int i = 0; i < file->buffer_count; i++) {
+		for (struct AS_LLElement *current = file->buffers[i]->head; current != NULL; current = current->next) {
+			current->syntax = NULL;
+			current->syntax_count = 0;
+			current->syntax_capacity = 0;
+			current->dirty = 1;
+		}
+	}
+
+	arena_reset(&file->syntax_arena);
+	file->syntax_waste = 0;
+}
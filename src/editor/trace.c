@@ -0,0 +1,195 @@
+/**
+ * @file trace.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Recording and replaying keystrokes, and measuring how long handling them takes.
+ * 
+ * A trace is a text file with a line per key: the microseconds since the
+ * recording started, the frame the key was read in and its keycode. Lines
+ * starting with '#' are comments.
+*/
+
+#include <editor/trace.h>
+
+#include <global.h>
+#include <util.h>
+
+/// The trace file being recorded to, NULL if none is.
+static FILE *record_file = NULL;
+/// The time the recording started.
+static uint64_t record_start = 0;
+/// Set (1) once the clock has been pinned to the times of a replayed trace.
+static bool clock_pinned = 0;
+/// The time the clock is pinned to.
+static uint64_t pinned_time = 0;
+
+uint64_t trace_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint64_t trace_clock() {
+	return clock_pinned ? pinned_time : trace_now();
+}
+
+void trace_pin_clock(uint64_t nanoseconds) {
+	clock_pinned = 1;
+	pinned_time = nanoseconds;
+}
+
+int trace_record_start(char *path) {
+	record_file = fopen(path, "w");
+
+	if (record_file == NULL) {
+		AS_DEBUG_MSG("Failed to open trace file %s\n", path);
+
+		return -1;
+	}
+
+	record_start = trace_now();
+	fprintf(record_file, "# Assembled %d.%d key trace: microseconds frame keycode\n", AS_VERSION_MAJ, AS_VERSION_MIN);
+
+	return 0;
+}
+
+void trace_record_key(int frame, int code) {
+	if (record_file == NULL) {
+		return;
+	}
+
+	fprintf(record_file, "%lu %d %d\n", (unsigned long)((trace_now() - record_start) / 1000), frame, code);
+}
+
+void trace_record_stop() {
+	if (record_file == NULL) {
+		return;
+	}
+
+	fclose(record_file);
+	record_file = NULL;
+}
+
+int trace_load(char *path, struct AS_Trace *trace) {
+	FILE *file = fopen(path, "r");
+
+	if (file == NULL) {
+		AS_DEBUG_MSG("Failed to open trace file %s\n", path);
+
+		return -1;
+	}
+
+	memset(trace, 0, sizeof(struct AS_Trace));
+
+	char line[128];
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		unsigned long time = 0;
+		int frame = 0;
+		int code = 0;
+
+		if (*line == '#' || sscanf(line, "%lu %d %d", &time, &frame, &code) != 3) {
+			// Comment, or not a key
+			continue;
+		}
+
+		if (trace->count >= trace->capacity) {
+			trace->capacity = max(trace->capacity * 2, 256);
+			trace->keys = (struct AS_TraceKey *)realloc(trace->keys, trace->capacity * sizeof(struct AS_TraceKey));
+		}
+
+		trace->keys[trace->count++] = (struct AS_TraceKey){ .time = time, .frame = frame, .code = code };
+	}
+
+	fclose(file);
+
+	return 0;
+}
+
+void trace_destroy(struct AS_Trace *trace) {
+	free(trace->keys);
+	memset(trace, 0, sizeof(struct AS_Trace));
+}
+
+void latency_add(struct AS_LatencyLog *log, uint64_t nanoseconds) {
+	if (log->count >= log->capacity) {
+		log->capacity = max(log->capacity * 2, 256);
+		log->samples = (uint64_t *)realloc(log->samples, log->capacity * sizeof(uint64_t));
+	}
+
+	log->samples[log->count++] = nanoseconds;
+}
+
+/**
+ * Order two samples for qsort.
+ * */
+static int compare_samples(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+uint64_t latency_percentile(struct AS_LatencyLog *log, int first, double percentile) {
+	int count = log->count - first;
+
+	if (count <= 0) {
+		return 0;
+	}
+
+	// Sort a copy, the log stays in the order it was taken
+	uint64_t *sorted = (uint64_t *)malloc(count * sizeof(uint64_t));
+	memcpy(sorted, log->samples + first, count * sizeof(uint64_t));
+	qsort(sorted, count, sizeof(uint64_t), compare_samples);
+
+	int i = (int)(percentile / 100.0 * (count - 1) + 0.5);
+	uint64_t sample = sorted[i];
+
+	// Memory Manage
+	free(sorted);
+
+	return sample;
+}
+
+void latency_report(FILE *file, char *name, struct AS_LatencyLog *log) {
+	uint64_t total = 0;
+	uint64_t largest = 0;
+
+	for (int i = 0; i < log->count; i++) {
+		total += log->samples[i];
+		largest = max(largest, log->samples[i]);
+	}
+
+	fprintf(file, "{ \"name\": \"%s\", \"count\": %d, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f }",
+		name, log->count, (log->count > 0) ? total / 1000.0 / log->count : 0.0, latency_percentile(log, 0, 50) / 1000.0,
+		latency_percentile(log, 0, 99) / 1000.0, largest / 1000.0);
+}
+
+void latency_destroy(struct AS_LatencyLog *log) {
+	free(log->samples);
+	memset(log, 0, sizeof(struct AS_LatencyLog));
+}
@@ -40,8 +40,9 @@
 /**
  * Syntax points for describing highlighting.
  *
- * A linked list which describes regions of text and
- * their color pairs.
+ * Describes a region of text and its color pair. Each line
+ * holds a contiguous array of these, sorted by `x` and
+ * non-overlapping.
  * */
 struct AS_SyntaxPoint {
 	/// Offset into AS_TextBuf->contents at which this applies
@@ -51,8 +52,6 @@ struct AS_SyntaxPoint {
 
 	/// The index of the color pair for this region
 	int color;
-	/// A pointer to the next syntax point, NULL if this is the last point
-	struct AS_SyntaxPoint *next;
 };
 
 /**
@@ -61,14 +60,41 @@ struct AS_SyntaxPoint {
  * A linked list which holds the all of the lines of
  * a column. */
 struct AS_LLElement {
-	/// Contains a single line of the open file (zero terminated, with no '\n' character).
+	/**
+	 * Contains a single line of the open file (with no '\n' character).
+	 *
+	 * If `capacity` is 0, this is a read-only view into the file's original
+	 * contents (or NULL for an empty line) and is not zero terminated.
+	 * It is copied into its own allocation the first time it is edited.
+	 * */
         char *contents;
+	/// The number of characters in `contents`, excluding any zero terminator.
+	size_t length;
+	/// The number of bytes allocated for `contents`, 0 if the line does not own `contents`.
+	size_t capacity;
 	/// A pointer to the next line, NULL if this is the last line.
         struct AS_LLElement *next;
 	/// A pointer to the previous line, NULL if this is the first line.
         struct AS_LLElement *prev;
-	/// A pointer to a linked list outlining how certain regions of `contents` is supposed to be colored.
+	/**
+	 * An array outlining how certain regions of `contents` are supposed to be colored, allocated from the file's syntax arena.
+	 *
+	 * Only the UI thread reads or writes this. It may describe an older `version` of the
+	 * line until the syntax worker's result for the current one has been applied.
+	 * */
 	struct AS_SyntaxPoint *syntax;
+	/// The number of points in `syntax`.
+	int syntax_count;
+	/// The number of points `syntax` has room for.
+	int syntax_capacity;
+	/// Incremented every time `contents` changes.
+	uint32_t version;
+	/// The number of syntax jobs for this line which have not been applied yet.
+	uint16_t syntax_jobs;
+	/// Set (1) when `contents` has changed since syntax was last requested for it.
+	uint8_t dirty;
+	/// Set (1) when the line has been freed while it still had syntax jobs.
+	uint8_t orphaned;
 };
 
 /**
@@ -99,6 +125,61 @@ struct AS_TextBuf {
 	struct AS_LLElement *selection_start_line;
 };
 
+/**
+ * Creates a new `struct AS_LLElement`
+ *
+ * Allocates a new, unlinked line containing a copy of the given text.
+ * No memory is allocated for the contents of an empty line. The line
+ * is marked dirty.
+ *
+ * @param const char *text - The text to copy into the line (may be NULL if length is 0).
+ * @param size_t length - The number of characters to copy from text.
+ * @return The pointer to the new struct AS_LLElement
+ * */
+struct AS_LLElement *new_line_list_element(const char *text, size_t length);
+/**
+ * Frees a `struct AS_LLElement`
+ *
+ * If the syntax worker still has jobs for the line, only its contents
+ * are freed, the line itself is freed once the last job is applied.
+ *
+ * @param struct AS_LLElement *element - The line to be freed.
+ * */
+void free_line_list_element(struct AS_LLElement *element);
+
+/**
+ * Ensure a line can hold the given number of characters.
+ *
+ * Grows `element->contents` geometrically, so that repeated insertions
+ * only reallocate a logarithmic number of times. Views are copied into
+ * their own allocation.
+ *
+ * @param struct AS_LLElement *element - The line to grow.
+ * @param size_t length - The number of characters (excluding the zero terminator) the line must be able to hold.
+ * */
+void line_reserve(struct AS_LLElement *element, size_t length);
+/**
+ * Insert text into a line.
+ *
+ * Marks the line dirty, and increments its version.
+ *
+ * @param struct AS_LLElement *element - The line to insert into.
+ * @param size_t x - The 0-based index at which to insert the text (clamped to the end of the line).
+ * @param const char *text - The text to insert.
+ * @param size_t length - The number of characters to insert from text.
+ * */
+void line_insert(struct AS_LLElement *element, size_t x, const char *text, size_t length);
+/**
+ * Erase text from a line.
+ *
+ * Marks the line dirty, and increments its version.
+ *
+ * @param struct AS_LLElement *element - The line to erase from.
+ * @param size_t x - The 0-based index of the first character to erase.
+ * @param size_t length - The number of characters to erase (clamped to the end of the line).
+ * */
+void line_erase(struct AS_LLElement *element, size_t x, size_t length);
+
 /**
  * Creates a new `struct AS_TextBuf`
  *
@@ -126,6 +207,31 @@ void destroy_buffer(struct AS_TextBuf *buffer);
  * */
 void buffer_char_insert(char c);
 
+/**
+ * Inserts text into the active buffer.
+ *
+ * The text is split into rows on newlines, and each row into cells on
+ * the layout's delimiter, which fill in the columns from the active one
+ * on (the last column takes the rest of the row). All new rows are linked
+ * in at once, and the insertion is undone in one step.
+ *
+ * Unlike typing '\\n', which only moves the active column's text after
+ * the cursor down a row, the cursor's row is split as text: the rest of
+ * the active cell and the cells of every column after it move down to the
+ * last inserted row, while the columns before the active one stay put.
+ * The pasted cells need those columns to be empty on the rows they fill,
+ * and this keeps the cells which followed the cursor together on one row.
+ * Pasting "1\\n2" after the 'a' of "abc|def|ghi" gives "a1||" and
+ * "2bc|def|ghi", as inserting the text into the file on disk would.
+ *
+ * The cursor is left after the text in the active column, on its last row.
+ *
+ * @param const char *text - The text to insert.
+ * @param size_t length - The number of characters in text.
+ * @return The number of rows inserted.
+ * */
+int buffer_insert_text(const char *text, size_t length);
+
 /**
  * Deletes the current character.
  *
@@ -36,8 +36,13 @@
 
 #include <editor/config.h>
 #include <editor/buffer/buffer.h>
+#include <editor/buffer/index.h>
+#include <editor/buffer/undo.h>
 
 #include <includes.h>
+#include <util.h>
+
+struct AS_FileMapping;
 
 /**
  * Describes a single open file.
@@ -55,8 +60,28 @@ struct AS_TextFile {
         int load_offset;
 	/// Path to the file.
         char *name;
-	/// Pointer to the open file.
-        FILE *file;
+	/// The syntax backend used to highlight the file, NULL if there is none.
+	struct AS_SyntaxBackendMeta *syntax_backend;
+	/// The arena from which the syntax points of every line are allocated.
+	struct AS_Arena syntax_arena;
+	/// The number of bytes in `syntax_arena` which belong to no line.
+	size_t syntax_waste;
+	/// The contents of the file when it was loaded (mapped read-only), lines which have not been edited are views into it.
+	char *original;
+	/// The size of `original` in bytes.
+	size_t original_size;
+	/// The entry `original` is guarded by against the file being truncated, NULL if it is not mapped from the file.
+	struct AS_FileMapping *mapping;
+	/// The offset within `original` of the first line which has not been loaded.
+	size_t load_end;
+	/// Set if the file has been changed since it was last saved.
+	bool modified;
+	/// The number of lines at the start of the file which are unchanged since it was loaded.
+	int original_lines;
+	/// Journal of changes which can be undone and redone.
+	struct AS_UndoLog undo;
+	/// Index from row numbers to the lines of every buffer.
+	struct AS_LineIndex line_index;
 	/// Array of pointers to all buffers.
         struct AS_TextBuf **buffers;
 	/// The buffer which is currently selected by the user.
@@ -90,6 +115,17 @@ struct AS_ColDesc {
  * */
 struct AS_TextFile *load_file(char *name);
 
+/**
+ * Make sure a number of lines of a file are loaded.
+ *
+ * Files are loaded a chunk at a time as their lines are needed, lines
+ * past the end of the file are never loaded.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int lines - The number of lines from the start of the file which should be loaded.
+ * */
+void load_file_lines(struct AS_TextFile *file, int lines);
+
 /**
  * Reloads the given file.
  *
@@ -98,20 +134,40 @@ void reload_file(struct AS_TextFile *file);
 
 /**
  * Wrapper of `reload_file` to reload all files in the list as_ctx.text_file_head.
+ *
+ * The files are reloaded in parallel with parallel_run.
  * */
 void reload_all();
 
 /**
  * Save the given file.
  *
+ * Symbolic links are followed, and the file keeps its owner and permissions.
+ * A file which fails to save is left marked as modified.
+ *
  * @param struct AS_TextFile * - The file to save.
+ * @return 0 on success, -1 if the file could not be saved.
  * */
-void save_file(struct AS_TextFile *file);
+int save_file(struct AS_TextFile *file);
 
 /**
- * Wrapper of save_file to save all files in the list as_ctx.text_file_head.
+ * Wrapper of save_file to save all modified files in the list as_ctx.text_file_head.
+ *
+ * The files are saved in parallel with parallel_run.
+ *
+ * @return The number of files which could not be saved.
+ * */
+int save_all();
+
+/**
+ * Record that a line of a file has been changed.
+ *
+ * Lines moved or deleted count as changes to the line they were at.
+ *
+ * @param struct AS_TextFile *file - The file which was changed.
+ * @param int line - The 0-based index of the first line which changed.
  * */
-void save_all();
+void mark_file_modified(struct AS_TextFile *file, int line);
 
 /**
  * Destroy the given file
@@ -125,6 +181,8 @@ void destroy_file(struct AS_TextFile *file);
 
 /**
  * Wrapper of destroy_file to destroy all files in the list as_ctx.text_file_head.
+ *
+ * The files are destroyed in parallel with parallel_run.
  * */
 void destroy_all();
 
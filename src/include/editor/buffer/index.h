@@ -0,0 +1,173 @@
+/**
+ * @file index.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * An order-statistic index over the lines of a file, shared by all of its columns,
+ * which finds the line at a given line number in O(log n).
+*/
+
+#ifndef AS_INDEX_H
+#define AS_INDEX_H
+
+#include <editor/buffer/buffer.h>
+
+#include <includes.h>
+#include <util.h>
+
+struct AS_TextFile;
+
+/**
+ * A single row of the index.
+ *
+ * A node of an implicit treap: it is ordered by its position, which is
+ * the number of nodes before it, and heap ordered by its priority.
+ * */
+struct AS_LineIndexNode {
+	/// The rows before this one in its subtree, NULL if there are none.
+	struct AS_LineIndexNode *left;
+	/// The rows after this one in its subtree, NULL if there are none.
+	struct AS_LineIndexNode *right;
+	/// Random priority, larger than that of every node in its subtree.
+	uint32_t priority;
+	/// The number of nodes in this subtree.
+	int size;
+	/// The line of each column at this row.
+	struct AS_LLElement *cells[];
+};
+
+/**
+ * An index over the rows of a file.
+ *
+ * It is built the first time it is needed, and kept in step with
+ * the column lists from then on. A zeroed structure is an index
+ * which has not been built.
+ * */
+struct AS_LineIndex {
+	/// The root of the treap, NULL if the index is empty.
+	struct AS_LineIndexNode *root;
+	/// Removed nodes which can be reused, linked through their left pointers.
+	struct AS_LineIndexNode *free_nodes;
+	/// The memory nodes are allocated from.
+	struct AS_Arena arena;
+	/// The number of columns (cells per node).
+	int columns;
+	/// State of the random priority generator.
+	uint32_t seed;
+	/// Set (1) once the index has been built.
+	bool built;
+};
+
+/**
+ * Get the number of rows in a file.
+ *
+ * Builds the file's index if it has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @return The number of rows.
+ * */
+int line_index_count(struct AS_TextFile *file);
+
+/**
+ * Get the line of a column at a row.
+ *
+ * Builds the file's index if it has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based row.
+ * @param int column - The 0-based column.
+ * @return The line, NULL if row or column is out of range.
+ * */
+struct AS_LLElement *line_index_get(struct AS_TextFile *file, int row, int column);
+
+/**
+ * Record a row inserted into the columns.
+ *
+ * Must be called after every column has had a line linked in
+ * before the lines at `row`. The cells of rows around the
+ * insertion are read back from the column lists. Does nothing
+ * if the index has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based position of the new row.
+ * */
+void line_index_insert(struct AS_TextFile *file, int row);
+
+/**
+ * Record rows inserted into the columns.
+ *
+ * As line_index_insert, for `count` rows starting at `row`.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based position of the first new row.
+ * @param int count - The number of new rows.
+ * */
+void line_index_insert_rows(struct AS_TextFile *file, int row, int count);
+
+/**
+ * Record a row removed from the columns.
+ *
+ * Must be called after every column has had its line at `row`
+ * unlinked. Does nothing if the index has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int row - The 0-based position of the removed row.
+ * */
+void line_index_erase(struct AS_TextFile *file, int row);
+
+/**
+ * Record rows linked onto the ends of the columns.
+ *
+ * Must be called after every column has had `count` lines linked
+ * on after its last line. Does nothing if the index has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int count - The number of new rows.
+ * */
+void line_index_append(struct AS_TextFile *file, int count);
+
+/**
+ * Read rows back from the column lists.
+ *
+ * Must be called after lines are moved between rows within a
+ * column. Rows outside of the file are ignored. Does nothing if
+ * the index has not been built.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @param int first - The first 0-based row which changed.
+ * @param int last - The last 0-based row which changed.
+ * */
+void line_index_refresh(struct AS_TextFile *file, int first, int last);
+
+/**
+ * Free a file's index.
+ *
+ * The index is left unbuilt, to be built again when next needed.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * */
+void line_index_destroy(struct AS_TextFile *file);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file scan.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Finds newlines and column delimiters in blocks of text, using the widest vector
+ * instructions the processor supports.
+*/
+
+#ifndef AS_SCAN_H
+#define AS_SCAN_H
+
+/// The number of bytes the loader hands to scan_block at a time.
+#define AS_SCAN_BLOCK_SIZE (64 * 1024)
+
+#include <includes.h>
+
+/**
+ * Find every newline and delimiter in a block of text.
+ *
+ * Writes the offsets of every '\n' and delimiter character found in
+ * block[0, length) into offsets, in ascending order. The implementation
+ * (AVX2, SSE2 or portable) is selected the first time this is called.
+ *
+ * @param const char *block - The block of text to scan.
+ * @param size_t length - The number of bytes in block.
+ * @param char delimiter - The column delimiter to look for alongside '\n'.
+ * @param uint32_t *offsets - Array of at least length elements to receive the offsets.
+ * @return The number of offsets written.
+ * */
+size_t scan_block(const char *block, size_t length, char delimiter, uint32_t *offsets);
+
+#endif
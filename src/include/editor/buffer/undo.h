@@ -0,0 +1,234 @@
+/**
+ * @file undo.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A journal of the changes made to a file, which can be undone and redone.
+*/
+
+#ifndef AS_UNDO_H
+#define AS_UNDO_H
+
+#include <includes.h>
+
+/// The default limit on the memory used by a file's undo journal.
+#define AS_UNDO_DEFAULT_LIMIT (16 * 1024 * 1024)
+
+struct AS_TextFile;
+
+/**
+ * The kinds of change which are journaled.
+ * */
+enum AS_UNDO_TYPES {
+	/// Text was inserted at (x, row) of a column.
+	AS_UNDO_INSERT,
+	/// Text was deleted from (x, row) of a column.
+	AS_UNDO_DELETE,
+	/// A row was split in two, at a position in each column.
+	AS_UNDO_SPLIT,
+	/// The row after `row` was joined onto the end of it.
+	AS_UNDO_JOIN,
+	/// The lines from `row` to `last` of a column were moved up a row.
+	AS_UNDO_MOVE_UP,
+	/// The lines from `row` to `last` of a column were moved down a row.
+	AS_UNDO_MOVE_DOWN,
+	/// The column layout was switched from `x` to `last`.
+	AS_UNDO_LAYOUT,
+};
+
+/**
+ * A single change made to a file.
+ *
+ * Changes are kept as row and column coordinates with a copy of the
+ * text they affect, never as pointers to lines, as the lines they
+ * touched may since have been freed.
+ * */
+struct AS_UndoEntry {
+	/// The kind of change (AS_UNDO_\a x).
+	int type;
+	/// Changes with the same group are undone and redone together.
+	int group;
+	/// The 0-based row the change was made at.
+	int row;
+	/// The 0-based column the change was made in, the active column for splits and joins.
+	int column;
+	/// Position of the text within the line, or the previous layout for AS_UNDO_LAYOUT.
+	int x;
+	/// The last row of moved lines, or the new layout for AS_UNDO_LAYOUT.
+	int last;
+	/// The number of bytes used in data.
+	size_t length;
+	/// The number of bytes allocated for data.
+	size_t capacity;
+	/// The text inserted, the text deleted last character first, or an int per column of the positions a row was split at.
+	char *data;
+	/// The next older change, NULL if this is the oldest.
+	struct AS_UndoEntry *prev;
+	/// The next newer change, or the next change to redo.
+	struct AS_UndoEntry *next;
+};
+
+/**
+ * The undo journal of a file.
+ *
+ * A zeroed structure is an empty journal.
+ * */
+struct AS_UndoLog {
+	/// The oldest change which can be undone, NULL if there is none.
+	struct AS_UndoEntry *oldest;
+	/// The newest change which can be undone, NULL if there is none.
+	struct AS_UndoEntry *newest;
+	/// The next change to redo, NULL if there is none.
+	struct AS_UndoEntry *redo;
+	/// The number of bytes used by all entries.
+	size_t size;
+	/// The group of the newest change.
+	int group;
+	/// Set (1) while changes are being grouped by undo_begin.
+	bool grouped;
+	/// Set (1) when the group being recorded did not fit in as_ctx.undo_limit, the rest of its changes are not recorded.
+	bool dropped;
+};
+
+/**
+ * Start grouping changes.
+ *
+ * Every change recorded until undo_end is undone in one step.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * */
+void undo_begin(struct AS_TextFile *file);
+
+/**
+ * Stop grouping changes.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * */
+void undo_end(struct AS_TextFile *file);
+
+/**
+ * Record text inserted into a line.
+ *
+ * Typing onto the end of the text last inserted extends the same change.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * @param int row - The 0-based row of the line.
+ * @param int column - The 0-based column of the line.
+ * @param int x - Where the text was inserted.
+ * @param const char *text - The text.
+ * @param size_t length - The length of the text.
+ * */
+void undo_record_insert(struct AS_TextFile *file, int row, int column, int x, const char *text, size_t length);
+
+/**
+ * Record text deleted from a line.
+ *
+ * Must be called before the text is deleted. Deleting the character
+ * before the text last deleted extends the same change.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * @param int row - The 0-based row of the line.
+ * @param int column - The 0-based column of the line.
+ * @param int x - Where the deleted text starts.
+ * @param const char *text - The text.
+ * @param size_t length - The length of the text.
+ * */
+void undo_record_delete(struct AS_TextFile *file, int row, int column, int x, const char *text, size_t length);
+
+/**
+ * Record a row split in two.
+ *
+ * The text of each column from xs[i] onwards was moved onto a new row after `row`.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * @param int row - The 0-based row which was split.
+ * @param int column - The active column.
+ * @param int *xs - Where each column was split.
+ * */
+void undo_record_split(struct AS_TextFile *file, int row, int column, int *xs);
+
+/**
+ * Record a row joined onto the end of the one before it.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * @param int row - The 0-based row which the next row was joined onto.
+ * @param int column - The active column.
+ * @param int *xs - The length of each column's line before the join.
+ * */
+void undo_record_join(struct AS_TextFile *file, int row, int column, int *xs);
+
+/**
+ * Record lines of a column moved by a row.
+ *
+ * @param struct AS_TextFile *file - The file being changed.
+ * @param int column - The 0-based column.
+ * @param int first - The first row which was moved.
+ * @param int last - The last row which was moved.
+ * @param bool up - Set if the lines were moved up, clear if they were moved down.
+ * */
+void undo_record_move(struct AS_TextFile *file, int column, int first, int last, bool up);
+
+/**
+ * Record the column layout being switched.
+ *
+ * Recorded in the journals of all files, as every file is repartitioned.
+ *
+ * @param int from - The index of the previous column descriptor.
+ * @param int to - The index of the new column descriptor.
+ * */
+void undo_record_layout(int from, int to);
+
+/**
+ * Undo the newest group of changes to a file.
+ *
+ * The cursor (cy, the active buffer and its cx) is placed at the change,
+ * the current and virtual head lines need to be found again by the caller.
+ *
+ * Undoing a layout switch saves every file first, as they are reloaded in
+ * the other layout.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @return 1 if anything was undone, 0 if there was nothing to undo, -1 if a layout switch was not undone as files could not be saved.
+ * */
+int undo(struct AS_TextFile *file);
+
+/**
+ * Redo the last group of changes undone in a file.
+ *
+ * The cursor is placed as by `undo`.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * @return 1 if anything was redone, 0 if there was nothing to redo, -1 if a layout switch was not redone as files could not be saved.
+ * */
+int redo(struct AS_TextFile *file);
+
+/**
+ * Free every change in a file's journal.
+ *
+ * @param struct AS_TextFile *file - The file.
+ * */
+void undo_destroy(struct AS_TextFile *file);
+
+#endif
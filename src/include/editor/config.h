@@ -89,6 +89,13 @@ enum AS_LEXSTRLOOKUP_IDXS {
 	AS_CFG_LOOKUP_MOVE_LN_DOWN,
 	AS_CFG_LOOKUP_COLDESC_LEFT,
 	AS_CFG_LOOKUP_COLDESC_RIGHT,
+	AS_CFG_LOOKUP_PAGE_UP,
+	AS_CFG_LOOKUP_PAGE_DOWN,
+	AS_CFG_LOOKUP_GOTO_LINE,
+	AS_CFG_LOOKUP_GOTO_SELECTION,
+	AS_CFG_LOOKUP_UNDO,
+	AS_CFG_LOOKUP_REDO,
+	AS_CFG_LOOKUP_PROFILER,
 
         AS_CFG_LOOKUP_KEYBOARD,
         AS_CFG_LOOKUP_START_SCR,
@@ -103,6 +110,9 @@ enum AS_LEXSTRLOOKUP_IDXS {
 	AS_CFG_LOOKUP_INCLUDE,
 	AS_CFG_LOOKUP_FOREGROUND,
 	AS_CFG_LOOKUP_BACKGROUND,
+	AS_CFG_LOOKUP_EDITOR,
+	AS_CFG_LOOKUP_UNDO_LIMIT,
+	AS_CFG_LOOKUP_TIMEOUT,
 };
 
 /**
@@ -126,6 +136,13 @@ static const char *As_LexStrLookup[] = {
 	[AS_CFG_LOOKUP_MOVE_LN_DOWN]  	= "move_line_down",
 	[AS_CFG_LOOKUP_COLDESC_LEFT]    = "column_left",
 	[AS_CFG_LOOKUP_COLDESC_RIGHT]   = "column_right",
+	[AS_CFG_LOOKUP_PAGE_UP]         = "page_up",
+	[AS_CFG_LOOKUP_PAGE_DOWN]       = "page_down",
+	[AS_CFG_LOOKUP_GOTO_LINE]       = "goto_line",
+	[AS_CFG_LOOKUP_GOTO_SELECTION]  = "goto_selection",
+	[AS_CFG_LOOKUP_UNDO]            = "undo",
+	[AS_CFG_LOOKUP_REDO]            = "redo",
+	[AS_CFG_LOOKUP_PROFILER]        = "profiler",
 
         [AS_CFG_LOOKUP_KEYBOARD]   	= "keyboard",
         [AS_CFG_LOOKUP_START_SCR]  	= "start_screen",
@@ -140,6 +157,9 @@ static const char *As_LexStrLookup[] = {
 	[AS_CFG_LOOKUP_INCLUDE]		= "include",
 	[AS_CFG_LOOKUP_FOREGROUND]      = "foreground",
 	[AS_CFG_LOOKUP_BACKGROUND]      = "background",
+	[AS_CFG_LOOKUP_EDITOR]          = "editor",
+	[AS_CFG_LOOKUP_UNDO_LIMIT]      = "undo_limit",
+	[AS_CFG_LOOKUP_TIMEOUT]         = "timeout",
 };
 
 /**
@@ -160,12 +180,30 @@ struct AS_CfgTok {
         struct AS_CfgTok *next;
 };
 
+struct AS_Arena;
+
 /**
  * General lex function that can be used for .cfg files.
  *
- * @param FILE *file - The file to lex.
- * @return A pointer to the head of a struct AS_CfgTok linked list, the list is owned by the caller. */
-struct AS_CfgTok *cfg_lex(FILE *file);
+ * The file is mapped into memory and lexed in place. The tokens and
+ * their strings are allocated from the arena, and are freed with it.
+ *
+ * @param char *path - The path of the file to lex.
+ * @param struct AS_Arena *arena - The arena to allocate the tokens from.
+ * @return A pointer to the head of a struct AS_CfgTok linked list, NULL if the file could not be read. */
+struct AS_CfgTok *cfg_lex(char *path, struct AS_Arena *arena);
+
+/**
+ * Get the tokens of a .cfg file, going through the config cache.
+ *
+ * While read_config runs, a file whose size and modification time (or
+ * failing that, contents) match those it was cached with is not lexed,
+ * its tokens are taken from the cache. Otherwise this is cfg_lex.
+ *
+ * @param char *path - The path of the file.
+ * @param struct AS_Arena *arena - The arena to allocate the tokens from.
+ * @return A pointer to the head of a struct AS_CfgTok linked list, NULL if the file could not be read. */
+struct AS_CfgTok *cfg_tokens(char *path, struct AS_Arena *arena);
 
 /**
  * Specific to read ~/.config/assembled/config.cfg
@@ -173,6 +211,9 @@ struct AS_CfgTok *cfg_lex(FILE *file);
  * This functions reads the first main configuration file
  * at ~/.config/assembled/config.cfg, which may point to other
  * configuration files.
+ *
+ * The tokens of every file read are cached in ~/.cache/assembled/config.cache
+ * for the next startup.
  * @return An integer to determine success (0: success)*/
 int read_config();
 
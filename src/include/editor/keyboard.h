@@ -37,19 +37,48 @@
 #include <global.h>
 #include <includes.h>
 
-/// Maximum number of elements on the key_stack.
+/// Maximum number of keys in a key sequence.
 #define AS_MAX_KEY_ELEMENTS 16
+/// The number of milliseconds to wait for the rest of a key sequence, unless configured.
+#define AS_KEY_TIMEOUT_DEFAULT 1000
+/// Key code of the sequence the terminal sends before pasted text (bracketed paste).
+#define AS_KEY_PASTE_BEGIN 0x1000
+/// Key code of the sequence the terminal sends after pasted text (bracketed paste).
+#define AS_KEY_PASTE_END 0x1001
 
 /**
  * Acknowledge keyboard input.
  *
- * Place the given character onto the key_stack at key_stack_ptr.
- * Then try to collapse the stack.
+ * Advances the active screen's keymap by the key. Once the keys
+ * pressed make up a sequence which no longer can be extended, its
+ * function is called on the active screen. Keys which do not start a
+ * sequence are inserted as characters.
+ *
+ * Keys between AS_KEY_PASTE_BEGIN and AS_KEY_PASTE_END are collected,
+ * and given to the active screen as one LOCAL_BUFFER_PASTE if it has
+ * SCR_OPT_PASTE set, or else fed in a key at a time.
  *
  * @param int c - Character to acknowledge.
  * */
 void key(int c);
 
+/**
+ * The time until the keys of an incomplete sequence are given up on.
+ *
+ * @return The number of milliseconds until keyboard_tick should be called, -1 if no keys are waiting.
+ * */
+int keyboard_timeout();
+
+/**
+ * Give up on the keys of an incomplete sequence, if they have waited too long.
+ *
+ * The longest complete sequence among them is called, otherwise they
+ * are inserted as characters.
+ *
+ * @return 1 if the keys were given up on, otherwise 0.
+ * */
+bool keyboard_tick();
+
 /**
  * Configure the keyboard.
  *
@@ -58,6 +87,10 @@ void key(int c);
  * token list. The token must be of type AS_CFG_TOKEN_KEY with
  * a value of AS_CFG_LOOKUP_KEYBOARD.
  *
+ * keyboard keyseq <function> : <key>, ... - Bind a sequence on every screen.
+ * keyboard <screen> keyseq <function> : <key>, ... - Bind a sequence on one screen, over those of every screen.
+ * keyboard timeout : <milliseconds> - How long to wait for the rest of a sequence.
+ *
  * @param struct AS_CfgTok *token - The token from which to start interpretation.
  * @return A pointer to the beginning of the next set of tokens.
  * */
@@ -35,8 +35,8 @@
 /**
  * Initialization function for the backend
  *
- * Will restructure the keywords array into a g_hash_table
- * if AS_GLIB_ENABLE is defined.
+ * Builds a perfect hash table from the keywords array, so that
+ * each identifier can be looked up with a single comparison.
  * @param int i - The position the backend should place itself in as_ctx.syn_backends
  * */
 void as_asm_backend_init(int i);
@@ -58,26 +58,83 @@ static const char *As_SyntaxExtNames[] = {
  * Representation of a backend
  * */
 struct AS_SyntaxBackendMeta {
-	/// The function to call to get syntax information.
-	struct AS_SyntaxPoint *(*get_syntax)(char *);
+	/**
+	 * The function to call to get syntax information for a line and its length.
+	 * Points are written into the given array, which has room for at least one
+	 * point per character, and the number of points written is returned.
+	 * */
+	int (*get_syntax)(char *, int, struct AS_SyntaxPoint *);
 	/// The number of file extensions this backend handles.
 	int extensions[AS_MAX_BACKEND_EXTS];
 };
 
 /**
  * Initalize as_ctx.syn_backends.
+ *
+ * Also starts the syntax worker thread.
  * */
 void init_syntax();
 
 /**
- * Wrapper function to get syntax for a file.
+ * Stop the syntax worker thread.
+ *
+ * Outstanding jobs are discarded.
+ * */
+void stop_syntax();
+
+/**
+ * Find the syntax backend for a file.
  *
  * This function determines which syntax backend to use based on the
  * file's extension.
  *
+ * @param char *name - Path to the file.
+ * @return A pointer to the backend within as_ctx.syn_backends, NULL if no backend handles the file.
+ * */
+struct AS_SyntaxBackendMeta *find_syntax_backend(char *name);
+
+/**
+ * Request the syntax of a line.
+ *
+ * Copies the line and queues it for the syntax worker, using the
+ * backend found for the file when it was loaded. The line keeps its
+ * current syntax points until the result is applied. Clears the
+ * line's dirty flag.
+ *
  * @param struct AS_TextFile *file - File in which next parameter is in.
- * @param struct AS_LLElement *element - The line for which to create a syntax point linked list.
+ * @param struct AS_LLElement *element - The line for which to request syntax points.
+ * */
+void request_syntax(struct AS_TextFile *file, struct AS_LLElement *element);
+
+/**
+ * Apply the syntax worker's results.
+ *
+ * Stores the points of every completed job in its line, unless the
+ * line has been edited since the job was requested. Never blocks on
+ * the worker (beyond a short lock), and must be called from the UI
+ * thread.
+ *
+ * @return 1 if any line's syntax changed, otherwise 0.
+ * */
+bool apply_syntax();
+
+/**
+ * Get the syntax worker's notification descriptor.
+ *
+ * @return An eventfd which is readable while the worker has results to apply.
+ * */
+int syntax_fd();
+
+/**
+ * Reclaim a file's unused syntax points.
+ *
+ * If most of the file's syntax arena is no longer used by any line,
+ * the arena is reset and every line is marked dirty so that it is
+ * highlighted again. Must not be called while syntax points are
+ * being iterated over.
+ *
+ * @param struct AS_TextFile *file - The file whose syntax arena should be checked.
  * */
-struct AS_SyntaxPoint *get_syntax(struct AS_TextFile *file, struct AS_LLElement *element);
+void collect_syntax(struct AS_TextFile *file);
 
 #endif
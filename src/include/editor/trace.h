@@ -0,0 +1,170 @@
+/**
+ * @file trace.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Recording and replaying keystrokes, and measuring how long handling them takes.
+*/
+
+#ifndef AS_TRACE_H
+#define AS_TRACE_H
+
+#include <includes.h>
+
+/**
+ * A key pressed while a trace was recorded.
+ * */
+struct AS_TraceKey {
+	/// Microseconds since the recording started.
+	uint64_t time;
+	/// The frame (pass of the main loop) the key was read in.
+	int frame;
+	/// The keycode returned by getch.
+	int code;
+};
+
+/**
+ * A recorded trace.
+ * */
+struct AS_Trace {
+	/// The keys in the order they were pressed.
+	struct AS_TraceKey *keys;
+	/// The number of keys.
+	int count;
+	/// The number of keys there is room for.
+	int capacity;
+};
+
+/**
+ * A set of latency samples.
+ * */
+struct AS_LatencyLog {
+	/// The samples in nanoseconds, in the order they were taken.
+	uint64_t *samples;
+	/// The number of samples.
+	int count;
+	/// The number of samples there is room for.
+	int capacity;
+};
+
+/**
+ * Start recording keys into a trace file.
+ *
+ * @param char *path - The file to write the trace to, it is truncated.
+ * @return 0 on success, -1 if the file could not be opened.
+ * */
+int trace_record_start(char *path);
+
+/**
+ * Record a key, if a trace is being recorded.
+ *
+ * @param int frame - The frame the key was read in.
+ * @param int code - The keycode.
+ * */
+void trace_record_key(int frame, int code);
+
+/**
+ * Stop recording, flushing and closing the trace file.
+ * */
+void trace_record_stop();
+
+/**
+ * Read a trace file.
+ *
+ * @param char *path - The trace file.
+ * @param struct AS_Trace *trace - Filled in with the keys of the trace.
+ * @return 0 on success, -1 if the file could not be read.
+ * */
+int trace_load(char *path, struct AS_Trace *trace);
+
+/**
+ * Free the keys of a trace.
+ *
+ * @param struct AS_Trace *trace - The trace.
+ * */
+void trace_destroy(struct AS_Trace *trace);
+
+/**
+ * The current time, for measuring latencies.
+ *
+ * @return Nanoseconds from an arbitrary point.
+ * */
+uint64_t trace_now();
+
+/**
+ * The time keys are considered to have been pressed at.
+ *
+ * Timeouts of key sequences are measured against this clock, so that a
+ * replayed trace times them out where they were when it was recorded.
+ *
+ * @return Nanoseconds from an arbitrary point, trace_now until the clock is pinned.
+ * */
+uint64_t trace_clock();
+
+/**
+ * Pin the clock returned by trace_clock to a time.
+ *
+ * @param uint64_t nanoseconds - The time.
+ * */
+void trace_pin_clock(uint64_t nanoseconds);
+
+/**
+ * Add a sample to a latency log.
+ *
+ * @param struct AS_LatencyLog *log - The log.
+ * @param uint64_t nanoseconds - The sample.
+ * */
+void latency_add(struct AS_LatencyLog *log, uint64_t nanoseconds);
+
+/**
+ * Find a percentile of the samples of a latency log.
+ *
+ * @param struct AS_LatencyLog *log - The log.
+ * @param int first - The index of the first sample to consider.
+ * @param double percentile - The percentile, from 0 to 100.
+ * @return The sample at the percentile, 0 if there are no samples.
+ * */
+uint64_t latency_percentile(struct AS_LatencyLog *log, int first, double percentile);
+
+/**
+ * Print the statistics of a latency log as a JSON object.
+ *
+ * The count, mean, 50th and 99th percentile and the largest sample
+ * are printed, in microseconds.
+ *
+ * @param FILE *file - Where to print.
+ * @param char *name - The name of the log.
+ * @param struct AS_LatencyLog *log - The log.
+ * */
+void latency_report(FILE *file, char *name, struct AS_LatencyLog *log);
+
+/**
+ * Free the samples of a latency log.
+ *
+ * @param struct AS_LatencyLog *log - The log.
+ * */
+void latency_destroy(struct AS_LatencyLog *log);
+
+#endif
@@ -81,6 +81,18 @@ struct AS_GlobalCtx {
 	struct AS_TextFile *text_file_head;
 	/// The current text file.
 	struct AS_TextFile *text_file;
+	/// The most memory in bytes the undo journal of each file may use.
+	size_t undo_limit;
+	/// The file mode creation mask of the process, read once at startup as reading it means setting it.
+	mode_t file_mask;
+	/// Set (1) when the frame-time profiler is shown on the editor's status line.
+	bool profiler;
+	/// Shows the progress of work on files which takes a while, NULL if there is nowhere to show it.
+	void (*progress)(char *action, int done, int total);
+	/// The text last pasted into the terminal, valid while LOCAL_BUFFER_PASTE is handled.
+	char *paste;
+	/// The number of characters in paste.
+	size_t paste_length;
 
 	// Columns
 	/// An array of all available column descriptors / layouts.
@@ -0,0 +1,115 @@
+/**
+ * @file frame.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A composed frame of cells, and the cells last drawn to the terminal, so that
+ * only rows which changed are drawn again.
+*/
+
+#ifndef AS_FRAME_H
+#define AS_FRAME_H
+
+#include <interface/interface.h>
+
+#include <includes.h>
+
+/**
+ * Begin composing a frame.
+ *
+ * Clears the composed frame to blanks, and resizes it to the
+ * render context. If the terminal has been cleared or resized
+ * since the last frame, every row is considered damaged.
+ *
+ * @param struct AS_RenderCtx *context - The render context of the frame.
+ * */
+void frame_begin(struct AS_RenderCtx *context);
+
+/**
+ * Turn attributes on for subsequently composed cells.
+ *
+ * Behaves like ncurses' attron, a color pair replaces the current one.
+ *
+ * @param chtype attributes - The attributes to turn on.
+ * */
+void frame_attron(chtype attributes);
+
+/**
+ * Turn attributes off for subsequently composed cells.
+ *
+ * Behaves like ncurses' attroff, any color pair turns off the current one.
+ *
+ * @param chtype attributes - The attributes to turn off.
+ * */
+void frame_attroff(chtype attributes);
+
+/**
+ * Compose a run of characters.
+ *
+ * All of the characters take the current attributes. Characters
+ * outside of the frame are ignored, the text does not wrap.
+ *
+ * @param int y - The row of the first cell.
+ * @param int x - The column of the first cell.
+ * @param const char *text - The characters to place in the cells (not necessarily zero terminated).
+ * @param int n - The number of characters.
+ * */
+void frame_addnstr(int y, int x, const char *text, int n);
+
+/**
+ * Compose a character.
+ *
+ * Characters outside of the frame are ignored.
+ *
+ * @param int y - The row of the cell.
+ * @param int x - The column of the cell.
+ * @param char c - The character to place in the cell.
+ * */
+void frame_addch(int y, int x, char c);
+
+/**
+ * Compose formatted text.
+ *
+ * The text does not wrap, characters beyond the end of the row
+ * are dropped.
+ *
+ * @param int y - The row of the first cell.
+ * @param int x - The column of the first cell.
+ * @param const char *format - printf style format string.
+ * */
+void frame_printw(int y, int x, const char *format, ...);
+
+/**
+ * Draw the composed frame.
+ *
+ * Only the range of each row which differs from the last drawn frame
+ * is handed to ncurses, as a single run of cells, so the following
+ * refresh only has to look at those.
+ *
+ * @return The number of cells drawn.
+ * */
+int frame_flush();
+
+#endif
@@ -62,6 +62,18 @@
 #define LOCAL_FILE_SAVE         11
 /// Local function code when the user wants to switch column descriptors (layouts).
 #define LOCAL_COLDESC_SWITCH    12
+/// Local function code when the user moves a page up or down.
+#define LOCAL_PAGE_MOVE         13
+/// Local function code when the user wants to go to a line.
+#define LOCAL_GOTO_LINE         14
+/// Local function code when the user wants to go to the start of the selection.
+#define LOCAL_GOTO_SELECTION    15
+/// Local function code when the user wants to undo (0) or redo (1) a change.
+#define LOCAL_UNDO              16
+/// Local function code when the user shows or hides the profiler.
+#define LOCAL_PROFILER          17
+/// Local function code when the user pastes text (as_ctx.paste).
+#define LOCAL_BUFFER_PASTE      18
 
 /// Determine if given coordinate is inside given bounding box.
 #define IN_BOUND(x, y, bound) \
@@ -80,6 +92,20 @@
  * This value is in AS_Screen.render_options.
  * */
 #define SCR_OPT_ALWAYS    (1 << 1)
+/**
+ * The screen draws every cell itself, the terminal is not
+ * erased before it is rendered.
+ *
+ * This value is in AS_Screen.render_options.
+ * */
+#define SCR_OPT_NO_ERASE  (1 << 2)
+/**
+ * The screen takes pasted text at once as LOCAL_BUFFER_PASTE,
+ * other screens are given it a key at a time.
+ *
+ * This value is in AS_Screen.render_options.
+ * */
+#define SCR_OPT_PASTE     (1 << 3)
 
 #include <includes.h>
 
@@ -107,6 +133,8 @@ struct AS_RenderCtx {
         int max_x;
 	/// Maximum Y-position.
         int max_y;
+	/// Incremented every time the terminal is erased or resized, screens which do not erase it compare against this.
+	int clear_count;
 };
 
 /**
@@ -0,0 +1,102 @@
+/**
+ * @file profiler.h
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Measures where the time of every frame goes, for the overlay on the editor's status line.
+*/
+
+#ifndef AS_PROFILER_H
+#define AS_PROFILER_H
+
+/// The number of frames the rolling percentiles are taken over.
+#define AS_PROFILE_WINDOW 120
+
+#include <includes.h>
+
+/**
+ * The phases of a frame which are timed.
+ * */
+enum AS_PROFILE_PHASES {
+	/// Reading and handling keys.
+	AS_PROFILE_INPUT,
+	/// The screen's update function.
+	AS_PROFILE_UPDATE,
+	/// The screen's render function.
+	AS_PROFILE_RENDER,
+	/// Refreshing the terminal.
+	AS_PROFILE_REFRESH,
+	AS_PROFILE_PHASE_COUNT,
+};
+
+/**
+ * The things counted during a frame.
+ * */
+enum AS_PROFILE_COUNTERS {
+	/// Lines sent to be highlighted.
+	AS_PROFILE_LEXED,
+	/// Cells written to the terminal.
+	AS_PROFILE_CELLS,
+	AS_PROFILE_COUNTER_COUNT,
+};
+
+/**
+ * Start timing a phase.
+ *
+ * @return The time the phase started, 0 if the profiler is disabled.
+ * */
+uint64_t profile_start();
+
+/**
+ * Stop timing a phase, adding the time since profile_start to the frame.
+ *
+ * @param int phase - The phase (AS_PROFILE_PHASES).
+ * @param uint64_t start - The value returned by profile_start.
+ * */
+void profile_stop(int phase, uint64_t start);
+
+/**
+ * Add to a counter of the frame.
+ *
+ * @param int counter - The counter (AS_PROFILE_COUNTERS).
+ * @param int count - The amount to add.
+ * */
+void profile_count(int counter, int count);
+
+/**
+ * Finish the current frame, it becomes the one shown by profile_format.
+ * */
+void profile_frame();
+
+/**
+ * Describe the last frame, and the rolling percentiles of whole frames.
+ *
+ * @param char *text - Where to write the description.
+ * @param size_t size - The size of text.
+ * @return The length of the description.
+ * */
+int profile_format(char *text, size_t size);
+
+#endif
@@ -48,11 +48,11 @@ void register_editor_screen();
  * This function is invoked by config.c's interpret_token_stream
  * function.
  *
- * Currently there is no configuration for the editor screen, therefore
- * the parameter is just returnd.
+ * editor undo_limit : <bytes> - Limit the memory used by the undo journal of each file.
+ * editor profiler : <0 or 1> - Show the frame-time profiler on the status line.
  *
- * @param struct AS_CfgTok *token - Currently just returned.
- * @return Currently just the input parameter.
+ * @param struct AS_CfgTok *token - The token after the "editor" keyword.
+ * @return The last token of the command.
  * */
 struct AS_CfgTok *configure_editor_screen(struct AS_CfgTok *token);
 
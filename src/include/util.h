@@ -32,6 +32,41 @@
 
 #include <includes.h>
 
+/// The smallest chunk an arena allocates.
+#define AS_ARENA_CHUNK_SIZE (64 * 1024)
+/// The most threads parallel_run works with.
+#define AS_MAX_WORKERS 16
+/// The number of milliseconds between reports of parallel_run's progress.
+#define AS_PROGRESS_INTERVAL 100
+
+/**
+ * A single block of memory owned by an arena.
+ * */
+struct AS_ArenaChunk {
+	/// The next (older) chunk, NULL if this is the first chunk.
+	struct AS_ArenaChunk *next;
+	/// The number of bytes in data.
+	size_t size;
+	/// The number of bytes of data which have been handed out.
+	size_t used;
+	/// The memory handed out by the arena.
+	char data[];
+};
+
+/**
+ * A bump allocator.
+ *
+ * Allocations are never freed individually, instead the whole
+ * arena is reset or destroyed at once. A zeroed structure is an
+ * empty arena.
+ * */
+struct AS_Arena {
+	/// The chunk allocations are currently made from, NULL if nothing has been allocated.
+	struct AS_ArenaChunk *head;
+	/// The total number of bytes in all chunks.
+	size_t size;
+};
+
 /**
  * Create a 64-bit hash from the given string input
  *
@@ -51,4 +86,57 @@ uint64_t general_hash(char *string);
  * */
 char *fpath2abs(char *path, int options);
 
+/**
+ * Allocate memory from an arena.
+ *
+ * @param struct AS_Arena *arena - The arena to allocate from.
+ * @param size_t size - The number of bytes to allocate.
+ * @return A pointer to the memory, aligned to 8 bytes. It is valid until the arena is reset or destroyed.
+ * */
+void *arena_alloc(struct AS_Arena *arena, size_t size);
+
+/**
+ * Reset an arena.
+ *
+ * Frees everything allocated from the arena, keeping its first
+ * chunk for reuse.
+ *
+ * @param struct AS_Arena *arena - The arena to reset.
+ * */
+void arena_reset(struct AS_Arena *arena);
+
+/**
+ * Destroy an arena.
+ *
+ * Frees all of the arena's memory, leaving it empty.
+ *
+ * @param struct AS_Arena *arena - The arena to destroy.
+ * */
+void arena_destroy(struct AS_Arena *arena);
+
+/**
+ * The number of threads parallel_run would work with.
+ *
+ * @return The number of processors (at most AS_MAX_WORKERS), 1 if called from a job of parallel_run.
+ * */
+int parallel_workers();
+
+/**
+ * Run independent jobs on a pool of threads.
+ *
+ * Calls job once for every index from 0 to count - 1, spread over
+ * a pool of a thread per processor, and returns once all of them are
+ * done. The pool is started by the first run which needs it, and its
+ * threads wait for the next run in between. While waiting,
+ * as_ctx.progress is told how many jobs are done every
+ * AS_PROGRESS_INTERVAL milliseconds. Jobs which call parallel_run
+ * themselves run their jobs inline.
+ *
+ * @param int count - The number of jobs.
+ * @param void (*job)(void *, int) - Called with argument and the index of a job.
+ * @param void *argument - Passed to every job.
+ * @param char *action - What the jobs are doing, shown with their progress, NULL to show nothing.
+ * */
+void parallel_run(int count, void (*job)(void *, int), void *argument, char *action);
+
 #endif
@@ -0,0 +1,183 @@
+/**
+ * @file frame.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A composed frame of cells, and the cells last drawn to the terminal, so that
+ * only rows which changed are drawn again.
+*/
+
+#include <interface/frame.h>
+#include <interface/interface.h>
+
+#include <global.h>
+#include <includes.h>
+#include <stdarg.h>
+
+/// The cells being composed, width * height.
+static chtype *composed = NULL;
+/// The cells on the terminal as of the last flush, width * height.
+static chtype *drawn = NULL;
+/// The number of columns in the frame.
+static int width = 0;
+/// The number of rows in the frame.
+static int height = 0;
+/// The value of AS_RenderCtx.clear_count when the frame was last drawn.
+static int drawn_clear_count = -1;
+/// Set (1) when every row must be drawn on the next flush.
+static bool damaged_all = 1;
+/// The attributes applied to composed cells.
+static chtype attributes = 0;
+
+void frame_begin(struct AS_RenderCtx *context) {
+	if (context->max_x != width || context->max_y != height) {
+		width = context->max_x;
+		height = context->max_y;
+
+		composed = (chtype *)realloc(composed, width * height * sizeof(chtype));
+		drawn = (chtype *)realloc(drawn, width * height * sizeof(chtype));
+
+		damaged_all = 1;
+	}
+
+	if (context->clear_count != drawn_clear_count) {
+		// Something else has been drawn over the terminal
+		drawn_clear_count = context->clear_count;
+		damaged_all = 1;
+	}
+
+	for (int i = 0; i < width * height; i++) {
+		composed[i] = ' ';
+	}
+
+	attributes = 0;
+}
+
+void frame_attron(chtype on) {
+	if (on & A_COLOR) {
+		// Only one color pair can be active
+		attributes &= ~A_COLOR;
+	}
+
+	attributes |= on;
+}
+
+void frame_attroff(chtype off) {
+	if (off & A_COLOR) {
+		off |= A_COLOR;
+	}
+
+	attributes &= ~off;
+}
+
+void frame_addnstr(int y, int x, const char *text, int n) {
+	if (y < 0 || y >= height) {
+		return;
+	}
+
+	// Clip to the row
+	if (x < 0) {
+		text -= x;
+		n += x;
+		x = 0;
+	}
+
+	n = min(n, width - x);
+
+	chtype *cell = &composed[y * width + x];
+
+	for (int i = 0; i < n; i++) {
+		unsigned char c = text[i];
+
+		// Control characters would move the terminal's cursor,
+		// draw them as single cells instead
+		if (c < ' ' || c == 0x7F) {
+			c = (c == '\t') ? ' ' : '^';
+		}
+
+		cell[i] = c | attributes;
+	}
+}
+
+void frame_addch(int y, int x, char c) {
+	frame_addnstr(y, x, &c, 1);
+}
+
+void frame_printw(int y, int x, const char *format, ...) {
+	char text[512];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	length = min(length, (int)sizeof(text) - 1);
+
+	// Like printw, a newline ends the row
+	char *newline = memchr(text, '\n', length);
+
+	if (newline != NULL) {
+		length = newline - text;
+	}
+
+	frame_addnstr(y, x, text, length);
+}
+
+int frame_flush() {
+	int cells = 0;
+
+	for (int y = 0; y < height; y++) {
+		chtype *row = &composed[y * width];
+		chtype *last = &drawn[y * width];
+
+		int start = 0;
+		int end = width;
+
+		if (!damaged_all) {
+			// Find the range of the row which changed
+			while (start < width && row[start] == last[start]) {
+				start++;
+			}
+
+			if (start == width) {
+				// Already on the terminal
+				continue;
+			}
+
+			while (row[end - 1] == last[end - 1]) {
+				end--;
+			}
+		}
+
+		mvaddchnstr(y, start, row + start, end - start);
+		memcpy(last + start, row + start, (end - start) * sizeof(chtype));
+
+		cells += end - start;
+	}
+
+	damaged_all = 0;
+
+	return cells;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file profiler.c
+ * @author awewsomegamer <awewsomegamer@gmail.com>
+ *
+ * @section LICENSE
+ *
+ * Assembled - Column based text editor
+ * Copyright (C) 2023-2024 awewsomegamer
+ *
+ * This file is apart of Assembled.
+ *
+ * Assembled is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * Measures where the time of every frame goes, for the overlay on the editor's status line.
+*/
+
+#include <interface/profiler.h>
+#include <editor/trace.h>
+
+#include <global.h>
+#include <util.h>
+
+/// The time spent in every phase of the current frame.
+static uint64_t phases[AS_PROFILE_PHASE_COUNT];
+/// The counters of the current frame.
+static int counters[AS_PROFILE_COUNTER_COUNT];
+/// The time spent in every phase of the last frame.
+static uint64_t last_phases[AS_PROFILE_PHASE_COUNT];
+/// The counters of the last frame.
+static int last_counters[AS_PROFILE_COUNTER_COUNT];
+/// The lengths of the last AS_PROFILE_WINDOW frames.
+static struct AS_LatencyLog frames = { 0 };
+/// The index in frames of the oldest frame, once the window is full.
+static int oldest = 0;
+
+uint64_t profile_start() {
+	return as_ctx.profiler ? trace_now() : 0;
+}
+
+void profile_stop(int phase, uint64_t start) {
+	if (start == 0) {
+		// Not started, the profiler was disabled
+		return;
+	}
+
+	phases[phase] += trace_now() - start;
+}
+
+void profile_count(int counter, int count) {
+	counters[counter] += count;
+}
+
+void profile_frame() {
+	if (!as_ctx.profiler) {
+		memset(counters, 0, sizeof(counters));
+
+		return;
+	}
+
+	uint64_t total = 0;
+
+	for (int i = 0; i < AS_PROFILE_PHASE_COUNT; i++) {
+		total += phases[i];
+	}
+
+	if (frames.count < AS_PROFILE_WINDOW) {
+		latency_add(&frames, total);
+	} else {
+		// Replace the oldest frame
+		frames.samples[oldest] = total;
+		oldest = (oldest + 1) % AS_PROFILE_WINDOW;
+	}
+
+	memcpy(last_phases, phases, sizeof(phases));
+	memcpy(last_counters, counters, sizeof(counters));
+	memset(phases, 0, sizeof(phases));
+	memset(counters, 0, sizeof(counters));
+}
+
+int profile_format(char *text, size_t size) {
+	int length = snprintf(text, size, "KEY %.2f UPD %.2f DRAW %.2f REF %.2f MS | P50 %.2f P99 %.2f | LEX %d CELLS %d",
+			      last_phases[AS_PROFILE_INPUT] / 1e6, last_phases[AS_PROFILE_UPDATE] / 1e6,
+			      last_phases[AS_PROFILE_RENDER] / 1e6, last_phases[AS_PROFILE_REFRESH] / 1e6,
+			      latency_percentile(&frames, 0, 50) / 1e6, latency_percentile(&frames, 0, 99) / 1e6,
+			      last_counters[AS_PROFILE_LEXED], last_counters[AS_PROFILE_CELLS]);
+
+	return min(length, (int)size - 1);
+}
@@ -33,6 +33,8 @@
 #include <editor/config.h>
 
 #include <interface/interface.h>
+#include <interface/frame.h>
+#include <interface/profiler.h>
 #include <interface/screens/editor_scr.h>
 #include <interface/theming/themes.h>
 
@@ -49,41 +51,107 @@ static int line_length = 0;
 static int offset = 0;
 static int differential = 0;
 
+/// Set (1) while the user is typing a line number to go to.
+static bool goto_prompt = 0;
+/// The line number typed so far.
+static int goto_target = 0;
+
+/**
+ * Move the cursor to a line.
+ *
+ * Lines are found through the file's line index, so the distance
+ * moved does not matter.
+ *
+ * @param int line - The 0-based line to move to (clamped to the file).
+ * @param int top - The 0-based line to show at the top of the screen, -1 to keep the
+ * current one if line is on screen, and to center line on screen otherwise.
+ * */
+static void jump_to_line(int line, int top) {
+	struct AS_TextFile *file = as_ctx.text_file;
+	int rows = as_ctx.render_ctx.max_y - 1;
+
+	// Lines past those loaded may be wanted
+	load_file_lines(file, max(line, top) + 2 * rows);
+
+	line = min(max(line, 0), line_index_count(file) - 1);
+
+	if (top == -1) {
+		top = offset;
+
+		if (line < offset || line >= offset + rows) {
+			top = line - rows / 2;
+		}
+	}
+
+	// The line has to be on screen
+	top = min(max(top, max(line - (rows - 1), 0)), line);
+
+	for (int i = 0; i < file->buffer_count; i++) {
+		file->buffers[i]->current_element = line_index_get(file, line, i);
+		file->buffers[i]->virtual_head = line_index_get(file, top, i);
+	}
+
+	CURSOR_Y = line;
+	offset = top;
+	differential = line - top;
+}
+
 /**
  * Draw a line with syntax highlighting
  *
+ * The line is drawn a run at a time, each syntax point and each gap
+ * between them is composed with a single call.
+ *
  * @param struct AS_Bound bounds - Contains more arguments (.x = cursor x (on screen), .y = cursor y (on screen), .w = maximum characters per row, .h = offset in current->contents).
  * @param struct AS_LLElement *current - Current unwrapped line to be printed.
- * @param struct AS_SyntaxPoint *syntax - First call: buffer->syntax, next call: The return value from the last invokation of this function.
- * @param int *section_start - An integer adjusted by this function for its future invokations, caller must not overwrite.
+ * @param int point - First call: 0, next call: The return value from the last invokation of this function.
+ * @return The index of the first syntax point which has not been completely drawn.
  * */
-static struct AS_SyntaxPoint *syntactic_mvprintw(struct AS_Bound bounds, struct AS_LLElement *current, struct AS_SyntaxPoint *syntax, int *section_start) {
+static int syntactic_mvprintw(struct AS_Bound bounds, struct AS_LLElement *current, int point) {
 	int x = bounds.x;
 	int y = bounds.y;
 	int max_x = bounds.w;
 	int offset = bounds.h;
 
-	// Iterate through string's length
-	for (int i = 0; i < min(strlen(current->contents) - offset, max_x); i++) {
-		if (syntax != NULL && (offset + i) == ((*section_start) + syntax->length)) {
-			// Reached end of syntax point, turn highlighting off
-			attroff(COLOR_PAIR(syntax->color));
-			syntax = syntax->next;
+	struct AS_SyntaxPoint *syntax = current->syntax;
+	int count = current->syntax_count;
+
+	int position = offset;
+	int end = offset + min((int)current->length - offset, max_x);
+
+	while (position < end) {
+		// Skip points which ended before this row
+		while (point < count && syntax[point].x + syntax[point].length <= position) {
+			point++;
 		}
 
-		if (syntax != NULL && (offset + i) == syntax->x) {
-			// Reached beginning of syntax point, turn highlighting on
-			*section_start = i;
-			attron(COLOR_PAIR(syntax->color));
+		int run_end = end;
+
+		if (point < count && position >= syntax[point].x) {
+			// Inside of a syntax point, draw up to its end in
+			// its color
+			run_end = min(end, syntax[point].x + syntax[point].length);
+			frame_attron(COLOR_PAIR(syntax[point].color));
+		} else if (point < count) {
+			// Draw up to the start of the next syntax point
+			run_end = min(end, syntax[point].x);
+		}
+
+		frame_addnstr(y, x + position - offset, current->contents + position, run_end - position);
+
+		if (point < count && run_end == syntax[point].x + syntax[point].length) {
+			// Reached end of syntax point, turn highlighting off
+			frame_attroff(COLOR_PAIR(syntax[point].color));
+			point++;
 		}
 
-		mvaddch(y, x + i, current->contents[i + offset]);
+		position = run_end;
 	}
 
-	// Return updated position in syntax list
+	// Return updated position in syntax points
 	// Caller will need to keep track of this for the
 	// current buffer
-	return syntax;
+	return point;
 }
 
 // BUG: When lines near the end of a file are wrapped,
@@ -93,6 +161,10 @@ static void render(struct AS_RenderCtx *context) {
 	struct AS_ColDesc descriptor = as_ctx.col_descs[as_ctx.col_desc_i];
 	struct AS_TextBuf *active_buffer = as_ctx.text_file->active_buffer;
 
+	// Compose the screen into a frame, only the rows which
+	// differ from the terminal are drawn
+	frame_begin(context);
+
 	// Create and initialize a list of current pointers
 	struct AS_LLElement **currents = (struct AS_LLElement **)calloc(descriptor.column_count, sizeof(struct AS_LLElement *));
 
@@ -106,14 +178,15 @@ static void render(struct AS_RenderCtx *context) {
 	int y = 0;
 
 	// Restrict cx to the end of the current line
-	line_length = strlen(active_buffer->current_element->contents);
+	line_length = active_buffer->current_element->length;
 
 	if (CURSOR_X > line_length) {
 		CURSOR_X = line_length;
 	}
 
-	// While you can read a line
-	while (currents[0] != NULL) {
+	// While you can read a line and there is room for it on screen
+	// (the last row is used for the status line)
+	while (currents[0] != NULL && y + element_wrap_distortion < context->max_y - 1) {
 		// Variables by which the above change
 		int applied_cy_distortion = 0;
 		int applied_element_distortion = 0;
@@ -136,7 +209,7 @@ static void render(struct AS_RenderCtx *context) {
 			}
 
 			// Calculate the number of lines that will wrap
-			int distortion = strlen(current->contents) / max_length;
+			int distortion = current->length / max_length;
 
 			// If the current distortion is larger than the one
 			// that will be applied at the end of the loop,
@@ -183,54 +256,58 @@ static void render(struct AS_RenderCtx *context) {
 			}
 
 			// Draw each line of the string
-			struct AS_SyntaxPoint *syntax = current->syntax;
-			int section_start = 0;
+			int point = 0;
 
-			for (int x = 0; x < strlen(current->contents); x += max_length) {
+			for (int x = 0; x < current->length; x += max_length) {
 				int yc = y + (x / max_length) + element_wrap_distortion;
 				int xc = descriptor.column_positions[i];
 
+				if (yc >= context->max_y - 1) {
+					// Wrapped off of the bottom of the screen
+					break;
+				}
+
 				// Highlight contents if selected
 				if (((start->y < true_y && end->y > true_y) || (start->y <= true_y && end->y >= true_y && as_ctx.text_file->selected_buffers != 0)) && selection) {
-					attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				} else {
-					attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				}
 
 				// Draw regular text
 				if (selection == 0 || selection_extreme == 0 || as_ctx.text_file->selected_buffers != 0) {
-					syntax = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc, .w = max_length, .h = x},
-							   current, syntax, &section_start);
+					point = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc, .w = max_length, .h = x},
+							   current, point);
 
 					continue;
 				}
 
 				// Enable or disble highlighting for first segment
 				if (extreme_side == 0) {
-					attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				} else if (char_mode > 0) {
-					attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				}
 
 				// Draw first segment
 				int length = min(max_length, max(0, abs(char_mode) - x));
 
-				syntax = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc, .w = max_length, .h = x},
-						   current, syntax, &section_start);
+				point = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc, .w = max_length, .h = x},
+						   current, point);
 
 				// Disable or enable highlighting for second segment
 				if (extreme_side == 0) {
-					attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attron(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				} else if (char_mode > 0) {
-					attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+					frame_attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 				}
 
 				// Draw second segment
-				syntax = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc + length, .w = max_length, .h = x + length},
-							    current, syntax, &section_start);
+				point = syntactic_mvprintw((struct AS_Bound){.y = yc, .x = xc + length, .w = max_length, .h = x + length},
+							    current, point);
 			}
 
-			attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
+			frame_attroff(COLOR_PAIR(AS_COLOR_HIGHLIGHT));
 
 			// Move onto the next line
 			currents[i] = currents[i]->next;
@@ -245,7 +322,18 @@ static void render(struct AS_RenderCtx *context) {
 	}
 
 	// Print information
-	mvprintw(context->max_y - 1, 0, "EDITING (%d, %d) %s", CURSOR_Y + 1, CURSOR_X + 1, as_ctx.editor_scr_message);
+	frame_printw(context->max_y - 1, 0, "EDITING (%d, %d) %s", CURSOR_Y + 1, CURSOR_X + 1, as_ctx.editor_scr_message);
+
+	if (as_ctx.profiler) {
+		// Show the last frame's times on the right of the status line
+		char text[256];
+		int length = profile_format(text, sizeof(text));
+
+		frame_addnstr(context->max_y - 1, max(context->max_x - length, 0), text, length);
+	}
+
+	// Draw the rows which changed
+	profile_count(AS_PROFILE_CELLS, frame_flush());
 
 	// Position the cursor appropriately
 	int column_start = active_buffer->col_start;
@@ -273,6 +361,10 @@ static void update(struct AS_RenderCtx *context) {
 		direction = -1;
 	}
 
+	// Load the lines on screen and a screen past them, so
+	// the cursor never reaches the end of what is loaded
+	load_file_lines(as_ctx.text_file, offset + 2 * context->max_y);
+
 	// Update virtual head when page scrolls down
 	for (int i = 0; (i < as_ctx.col_descs[as_ctx.col_desc_i].column_count) && (direction != 0); i++) {
 		struct AS_LLElement *element = as_ctx.text_file->buffers[i]->virtual_head;
@@ -290,25 +382,23 @@ static void update(struct AS_RenderCtx *context) {
 		currents[i] = as_ctx.text_file->buffers[i]->virtual_head;
 	}
 
-	// Update syntax highlighting
-	while (currents[0] != NULL) {
+	// Reclaim syntax points left behind by edited lines
+	collect_syntax(as_ctx.text_file);
+
+	// Update syntax highlighting of the lines on screen which
+	// have changed since they were last highlighted, lines off
+	// screen are left until they are scrolled onto it
+	for (int y = 0; y < context->max_y && currents[0] != NULL; y++) {
 		for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
 			if (currents[i] == NULL) {
 				continue;
 			}
 
-			if (currents[i]->syntax != NULL) {
-				struct AS_SyntaxPoint *current = currents[i]->syntax;
-
-				while (current != NULL) {
-					struct AS_SyntaxPoint *tmp = current;
-					current = current->next;
-					// ERROR: Causes global mainfree(): invalid size
-					free(tmp);
-				}
+			if (currents[i]->dirty) {
+				request_syntax(as_ctx.text_file, currents[i]);
+				profile_count(AS_PROFILE_LEXED, 1);
 			}
 
-			currents[i]->syntax = get_syntax(as_ctx.text_file, currents[i]);
 			currents[i] = currents[i]->next;
 		}
 	}
@@ -320,6 +410,47 @@ static void update(struct AS_RenderCtx *context) {
 static void local(int code, int value) {
 	struct AS_ColDesc descriptor = as_ctx.col_descs[as_ctx.col_desc_i];
 
+	if (goto_prompt && code == LOCAL_BUFFER_PASTE) {
+		// The prompt takes the text a key at a time, whatever is
+		// left once it ends is pasted
+		size_t i = 0;
+
+		while (goto_prompt && i < as_ctx.paste_length) {
+			char c = as_ctx.paste[i++];
+			local((c == '\n') ? LOCAL_ENTER : LOCAL_BUFFER_CHAR, (unsigned char)c);
+		}
+
+		as_ctx.paste += i;
+		as_ctx.paste_length -= i;
+
+		if (as_ctx.paste_length == 0) {
+			return;
+		}
+	}
+
+	if (goto_prompt) {
+		// The user is typing a line number
+		if (code == LOCAL_BUFFER_CHAR && isdigit(value) && goto_target < 100000000) {
+			goto_target = goto_target * 10 + (value - '0');
+		} else if (code == LOCAL_BUFFER_CHAR && (value == '\b' || value == 263 || value == 127)) {
+			goto_target /= 10;
+		} else {
+			// Anything else ends the prompt
+			goto_prompt = 0;
+
+			if (code == LOCAL_ENTER && goto_target > 0) {
+				jump_to_line(goto_target - 1, -1);
+				sprintf(as_ctx.editor_scr_message, "LINE %d\n", CURSOR_Y + 1);
+			}
+
+			return;
+		}
+
+		sprintf(as_ctx.editor_scr_message, "GOTO LINE: %d", goto_target);
+
+		return;
+	}
+
 	switch (code) {
 	// ERROR: The YMOVE and XMOVE can sometimes result
 	//        in the cursor being locked out of bounds
@@ -406,10 +537,7 @@ static void local(int code, int value) {
 
 			if (selection) {
 				// Compute the pointer to the selection start
-				buffer->selection_start_line = buffer->current_element;
-				for (int i = 0; i < abs(CURSOR_Y - start.y); i++) {
-					buffer->selection_start_line = (CURSOR_Y > start.y ? buffer->selection_start_line->prev : buffer->selection_start_line->prev);
-				}
+				buffer->selection_start_line = line_index_get(as_ctx.text_file, start.y, i + value);
 
 				// Change selected buffer count
 				as_ctx.text_file->selected_buffers += value;
@@ -483,6 +611,9 @@ static void local(int code, int value) {
 		struct AS_TextBuf *buffer = NULL;
 		bool moved = 0;
 
+		// The lines of every selected buffer are moved in one step
+		undo_begin(as_ctx.text_file);
+
 		// TODO: There is probably a cleaner way of doing this
 		for (int i = -as_ctx.text_file->selected_buffers; i != 0;) {
 			// Move a line down in selected buffers
@@ -515,6 +646,8 @@ static void local(int code, int value) {
 		}
 		// TODO END
 
+		undo_end(as_ctx.text_file);
+
 		// Make sure other buffers are on the same line, that is
 		// if they are not selected
 		for (int i = 0; i < descriptor.column_count; i++) {
@@ -544,21 +677,37 @@ static void local(int code, int value) {
 
 	case LOCAL_FILE_SAVE: {
 		if (value == 1) {
-			save_all();
-			sprintf(as_ctx.editor_scr_message, "SAVED ALL FILES\n");
+			int failed = save_all();
+
+			if (failed > 0) {
+				sprintf(as_ctx.editor_scr_message, "FAILED TO SAVE %d FILES\n", failed);
+			} else {
+				sprintf(as_ctx.editor_scr_message, "SAVED ALL FILES\n");
+			}
 
 			break;
 		}
 
-		save_file(as_ctx.text_file);
-		sprintf(as_ctx.editor_scr_message, "SAVED FILE\n");
+		if (save_file(as_ctx.text_file) != 0) {
+			sprintf(as_ctx.editor_scr_message, "FAILED TO SAVE FILE\n");
+		} else {
+			sprintf(as_ctx.editor_scr_message, "SAVED FILE\n");
+		}
 
 		break;
 	}
 
 	case LOCAL_COLDESC_SWITCH: {
 		if (as_ctx.col_desc_i + value >= 0 && as_ctx.col_desc_i + value < AS_MAX_COLUMNS) {
-			save_all();
+			// Files are reloaded in the new layout, which would lose
+			// the edits of any file which could not be saved
+			int failed = save_all();
+
+			if (failed > 0) {
+				sprintf(as_ctx.editor_scr_message, "FAILED TO SAVE %d FILES, LAYOUT NOT SWITCHED\n", failed);
+
+				break;
+			}
 
 			as_ctx.col_desc_i += value;
 
@@ -566,22 +715,163 @@ static void local(int code, int value) {
 				break;
 			}
 
+			undo_record_layout(as_ctx.col_desc_i - value, as_ctx.col_desc_i);
 			reload_all();
 		}
 
 		break;
 	}
+
+	case LOCAL_PAGE_MOVE: {
+		int rows = as_ctx.render_ctx.max_y - 1;
+
+		jump_to_line(CURSOR_Y + value * rows, offset + value * rows);
+		sprintf(as_ctx.editor_scr_message, "PAGE %s\n", (value == -1 ? "UP" : "DOWN"));
+
+		break;
+	}
+
+	case LOCAL_GOTO_LINE: {
+		goto_prompt = 1;
+		goto_target = 0;
+		sprintf(as_ctx.editor_scr_message, "GOTO LINE: ");
+
+		break;
+	}
+
+	case LOCAL_GOTO_SELECTION: {
+		struct AS_TextBuf *active_buffer = as_ctx.text_file->active_buffer;
+
+		if (active_buffer->selection_enabled == 0) {
+			sprintf(as_ctx.editor_scr_message, "NO SELECTION\n");
+
+			break;
+		}
+
+		// Swap the cursor with the start of the selection, so
+		// that the same lines stay selected
+		struct AS_Bound start = active_buffer->selection_start;
+
+		for (int i = 0; i < as_ctx.text_file->buffer_count; i++) {
+			struct AS_TextBuf *buffer = as_ctx.text_file->buffers[i];
+
+			if (buffer->selection_enabled) {
+				buffer->selection_start.x = CURSOR_X;
+				buffer->selection_start.y = CURSOR_Y;
+				buffer->selection_start_line = buffer->current_element;
+			}
+		}
+
+		jump_to_line(start.y, -1);
+		CURSOR_X = start.x;
+
+		sprintf(as_ctx.editor_scr_message, "SELECTION START\n");
+
+		break;
+	}
+
+	case LOCAL_BUFFER_PASTE: {
+		int rows = buffer_insert_text(as_ctx.paste, as_ctx.paste_length);
+
+		// The new rows may have pushed the cursor off screen
+		jump_to_line(CURSOR_Y, -1);
+		sprintf(as_ctx.editor_scr_message, "PASTED %d LINES\n", rows + 1);
+
+		break;
+	}
+
+	case LOCAL_PROFILER: {
+		as_ctx.profiler = !as_ctx.profiler;
+		sprintf(as_ctx.editor_scr_message, "PROFILER %s\n", (as_ctx.profiler ? "ON" : "OFF"));
+
+		break;
+	}
+
+	case LOCAL_UNDO: {
+		int changed = (value == 0) ? undo(as_ctx.text_file) : redo(as_ctx.text_file);
+
+		if (changed == -1) {
+			sprintf(as_ctx.editor_scr_message, "FAILED TO SAVE FILES, NOTHING %s\n", (value == 0 ? "UNDONE" : "REDONE"));
+
+			break;
+		}
+
+		if (changed == 0) {
+			sprintf(as_ctx.editor_scr_message, "NOTHING TO %s\n", (value == 0 ? "UNDO" : "REDO"));
+
+			break;
+		}
+
+		// The cursor was placed at the change, bring it on screen
+		jump_to_line(CURSOR_Y, -1);
+		sprintf(as_ctx.editor_scr_message, "%s\n", (value == 0 ? "UNDO" : "REDO"));
+
+		break;
+	}
+	}
+}
+
+/**
+ * Show the progress of work on files on the status line.
+ *
+ * Called while the main loop is blocked, so the line is drawn
+ * straight onto the terminal.
+ *
+ * @param char *action - What is being done to the files.
+ * @param int done - The number of files which are done.
+ * @param int total - The number of files being worked on.
+ * */
+static void progress(char *action, int done, int total) {
+	if (as_ctx.screen == NULL || as_ctx.screen->render != render) {
+		return;
 	}
+
+	mvprintw(as_ctx.render_ctx.max_y - 1, 0, "%s %d/%d FILES", action, done, total);
+	clrtoeol();
+	refresh();
+
+	// The status line no longer matches the last frame
+	as_ctx.render_ctx.clear_count++;
 }
 
 void register_editor_screen() {
 	AS_DEBUG_MSG("Registering editor screen\n");
 
 	int i = register_screen("editor", render, update, local);
-	as_ctx.screens[i].render_options |= SCR_OPT_ON_UPDATE;
+	as_ctx.screens[i].render_options |= SCR_OPT_ON_UPDATE | SCR_OPT_NO_ERASE | SCR_OPT_PASTE;
+
+	as_ctx.progress = progress;
 }
 
 struct AS_CfgTok *configure_editor_screen(struct AS_CfgTok *token) {
+	// editor undo_limit : 16777216
+	// editor profiler : 1
+	AS_EXPECT_TOKEN(AS_CFG_TOKEN_KEY, "Expected keyword")
+
+	switch (token->value) {
+	case AS_CFG_LOOKUP_UNDO_LIMIT: {
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_COL, "Expected colon")
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_INT, "Expected integer")
+
+		as_ctx.undo_limit = max(token->value, 0);
+
+		break;
+	}
+
+	case AS_CFG_LOOKUP_PROFILER: {
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_COL, "Expected colon")
+		AS_NEXT_TOKEN
+		AS_EXPECT_TOKEN(AS_CFG_TOKEN_INT, "Expected integer")
+
+		as_ctx.profiler = (token->value != 0);
+
+		break;
+	}
+	}
+
 	return token;
 }
 
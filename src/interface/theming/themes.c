@@ -67,11 +67,16 @@ static struct AS_Color custom_colors[32];
  * found by the configuration function. Themes will overwrite
  * each other, but not clear the custom_colors array.
  *
- * @param FILE *file - The theme.cfg file.
+ * @param char *path - The path of the theme.cfg file.
  * */
-static void read_theme(FILE *file) {
-        struct AS_CfgTok *token = cfg_lex(file);
-        struct AS_CfgTok *current = token;
+static void read_theme(char *path) {
+	struct AS_Arena arena = { 0 };
+        struct AS_CfgTok *token = cfg_tokens(path, &arena);
+
+        if (token == NULL) {
+                printf("Failed to open file %s\n", path);
+                exit(1);
+        }
 
         while (token->type != AS_CFG_TOKEN_EOF) {
                 AS_EXPECT_TOKEN(AS_CFG_TOKEN_INT, "Expected integer");
@@ -107,17 +112,8 @@ static void read_theme(FILE *file) {
                 custom_colors[idx].information |= 1;
         }
 
-        AS_DEBUG_MSG("Token list:\n");
-	// TODO: Make linked list freeing a macro
-        while (current != NULL) {
-                AS_DEBUG_MSG("%d { 0x%02X, \"%s\", (%d, %d) } %p\n", current->type, current->value, current->str, current->line, current->column, current->next);
-		struct AS_CfgTok *tmp = current->next;
-
-                free(current);
-
-                current = tmp;
-        }
-        AS_DEBUG_MSG("List end\n");
+        // Memory Manage
+	arena_destroy(&arena);
 }
 
 void register_custom_colors() {
@@ -162,17 +158,12 @@ struct AS_CfgTok *configure_theme(struct AS_CfgTok *token) {
                         strcat(path, token->str);
                 }
 
-                FILE *theme_file = fopen(path, "r");
+                read_theme(path);
 
-                if (theme_file == NULL) {
-                        printf("Failed to open file %s\n", path);
-                        exit(1);
+                if (path != token->str) {
+                        free(path);
                 }
 
-                read_theme(theme_file);
-
-                fclose(theme_file);
-
                 break;
         }
         }
@@ -32,17 +32,65 @@
 #include <editor/buffer/editor.h>
 #include <editor/keyboard.h>
 #include <editor/config.h>
+#include <editor/trace.h>
 
 #include <interface/screens/editor_scr.h>
 #include <interface/screens/file_load_scr.h>
 #include <interface/theming/themes.h>
 #include <interface/interface.h>
 #include <interface/screens/start.h>
+#include <interface/profiler.h>
 
 #include <global.h>
 #include <util.h>
 #include <includes.h>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+/**
+ * Indices of the descriptors the main loop waits on.
+ * */
+enum AS_MAIN_FDS {
+	AS_FD_INPUT,
+	AS_FD_SIGNAL,
+	AS_FD_TIMER,
+	AS_FD_SYNTAX,
+	AS_FD_COUNT,
+};
+
+/**
+ * The phases of handling a frame whose latencies are measured
+ * when a trace is replayed.
+ * */
+enum AS_REPLAY_PHASES {
+	/// Handling keys, the screen's local function.
+	AS_REPLAY_LOCAL,
+	/// The screen's update function.
+	AS_REPLAY_UPDATE,
+	/// The screen's render function.
+	AS_REPLAY_RENDER,
+	/// Refreshing the terminal.
+	AS_REPLAY_REFRESH,
+	/// The whole frame.
+	AS_REPLAY_FRAME,
+	AS_REPLAY_PHASE_COUNT,
+};
+
+/**
+ * Names of the phases, as they are reported.
+ * */
+static const char *replay_phase_names[] = {
+	[AS_REPLAY_LOCAL]   = "local",
+	[AS_REPLAY_UPDATE]  = "update",
+	[AS_REPLAY_RENDER]  = "render",
+	[AS_REPLAY_REFRESH] = "refresh",
+	[AS_REPLAY_FRAME]   = "frame",
+};
+
 /**
  * Controls whether the main loop is running (1) or not (0).
  * */
@@ -51,6 +99,11 @@ bool running = 1;
  * Set when new input from the keyboard is present, otherwise 0.
  * */
 bool update = 0;
+/**
+ * The number of passes the main loop has made, keys read in the
+ * same pass are recorded in the same frame.
+ * */
+int frame = 0;
 /**
  * Debug log file pointer.
  *
@@ -68,12 +121,26 @@ struct AS_GlobalCtx as_ctx = { 0 };
  * Initialize ncurses library
  *
  * Initialize the terminal.
+ *
+ * @param bool headless - Draw into /dev/null instead of the terminal (1), used to replay traces.
  * */
-void init_ncurses() {
+void init_ncurses(bool headless) {
         AS_DEBUG_MSG("Initializing ncurses\n");
         setlocale(LC_ALL, "UTF-8");
 
-        initscr();
+        if (headless) {
+                char *type = getenv("TERM");
+                FILE *output = fopen("/dev/null", "w");
+                FILE *input = fopen("/dev/null", "r");
+
+                if (output == NULL || input == NULL || newterm((type != NULL) ? type : "xterm", output, input) == NULL) {
+                        printf("Failed to create a headless terminal\n");
+                        exit(1);
+                }
+        } else {
+                initscr();
+        }
+
         cbreak();
         noecho();
         
@@ -81,6 +148,16 @@ void init_ncurses() {
         keypad(stdscr, TRUE);
         nodelay(stdscr, TRUE);
 
+	// Have the terminal mark pasted text, so that it can be
+	// inserted at once rather than typed a key at a time
+	define_key("\033[200~", AS_KEY_PASTE_BEGIN);
+	define_key("\033[201~", AS_KEY_PASTE_END);
+
+	if (!headless) {
+		printf("\033[?2004h");
+		fflush(stdout);
+	}
+
         if (has_colors()) {
                 AS_DEBUG_MSG("Terminal has colors\n");
 
@@ -106,6 +183,39 @@ void init_ncurses() {
         AS_DEBUG_MSG("Initialized ncurses\n");
 }
 
+/**
+ * Handle a key from the keyboard.
+ *
+ * Clears the message, triggers an update and tells the
+ * keyboard to handle the key.
+ *
+ * @param int c - The key.
+ * */
+void handle_key(int c) {
+        sprintf(as_ctx.editor_scr_message, "");
+        update = 1;
+
+        key(c);
+}
+
+/**
+ * Update the current screen.
+ *
+ * Applies lines highlighted in the background, then runs
+ * the screen's update function if it has one.
+ * */
+void update_screen() {
+	// Pick up lines highlighted in the background
+	if (apply_syntax()) {
+		update = 1;
+	}
+
+	// Udate the screen if it exists and has an update function
+        if (as_ctx.screen != NULL && as_ctx.screen->update != NULL) {
+                as_ctx.screen->update(&as_ctx.render_ctx);
+        }
+}
+
 /**
  * Update the state of the editor
  *
@@ -113,47 +223,311 @@ void init_ncurses() {
  * updates the current screen.
  * */
 void editor() {
-	// Read in current key
-        int c = getch();
+	// Read in every pending key
+        int c = 0;
+        uint64_t start = profile_start();
 
-        if (c > -1) {
-		// If a key is present, cleaar the message,
-		// trigger an update and tell the keyboard to
-		// handle the key
-                sprintf(as_ctx.editor_scr_message, "");
-                update = 1;
+	// Give up on a key sequence which was left incomplete
+	if (keyboard_tick()) {
+		update = 1;
+	}
 
-                key(c);
+        while ((c = getch()) > -1) {
+                trace_record_key(frame, c);
+                handle_key(c);
         }
 
-	// Udate the screen if it exists and has an update function
-        if (as_ctx.screen != NULL && as_ctx.screen->update != NULL) {
-                as_ctx.screen->update(&as_ctx.render_ctx);
-        }
+        profile_stop(AS_PROFILE_INPUT, start);
+        frame++;
+
+        start = profile_start();
+        update_screen();
+        profile_stop(AS_PROFILE_UPDATE, start);
 }
 
 /**
- * Render the current screen
+ * Draw the current screen, without refreshing the terminal.
  *
- * Render the current active screen, clearing
- * the screen in the process
+ * Clears the screen in the process unless the screen
+ * has SCR_OPT_NO_ERASE
  * */
-void interface() {
-        erase();
+void draw_screen() {
+	// Screens which draw every cell keep track of what is
+	// on the terminal themselves
+        if (as_ctx.screen == NULL || !(as_ctx.screen->render_options & SCR_OPT_NO_ERASE)) {
+                erase();
+                as_ctx.render_ctx.clear_count++;
+        }
 
 	// Draw the screen if it exists and has a render function
         if (as_ctx.screen != NULL && as_ctx.screen->render != NULL) {
                 as_ctx.screen->render(&as_ctx.render_ctx);
         }
-        
+}
+
+/**
+ * Render the current screen
+ *
+ * Render the current active screen, and refresh
+ * the terminal. This ends a frame of the profiler.
+ * */
+void interface() {
+        uint64_t start = profile_start();
+        draw_screen();
+        profile_stop(AS_PROFILE_RENDER, start);
+
+        start = profile_start();
         refresh();
+        profile_stop(AS_PROFILE_REFRESH, start);
+
+        profile_frame();
+}
+
+/**
+ * Route signals through a descriptor.
+ *
+ * Blocks SIGINT and SIGWINCH, so that they can be waited on
+ * alongside input. Must be called before any threads are
+ * created, so that they inherit the mask.
+ *
+ * @return A signalfd which is readable when either signal is pending.
+ * */
+int init_signals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGWINCH);
+
+        sigprocmask(SIG_BLOCK, &signals, NULL);
+
+        return signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+}
+
+/**
+ * Handle pending signals.
+ *
+ * Stops the main loop on SIGINT, and resizes the terminal
+ * on SIGWINCH.
+ *
+ * @param int fd - The descriptor returned by init_signals.
+ * @return 1 if the screen needs to be redrawn, otherwise 0.
+ * */
+bool handle_signals(int fd) {
+        struct signalfd_siginfo info;
+        bool redraw = 0;
+
+        while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGINT) {
+                        running = 0;
+                        continue;
+                }
+
+                struct winsize size;
+
+                if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0) {
+                        resizeterm(size.ws_row, size.ws_col);
+
+                        as_ctx.render_ctx.max_x = size.ws_col;
+                        as_ctx.render_ctx.max_y = size.ws_row;
+                        as_ctx.render_ctx.clear_count++;
+
+                        redraw = 1;
+                }
+        }
+
+        return redraw;
+}
+
+/**
+ * Start or stop the animation timer.
+ *
+ * @param int fd - The timerfd to arm.
+ * @param bool enable - Fire every TARGET_FPS seconds (1), or never (0).
+ * */
+void arm_timer(int fd, bool enable) {
+        long interval = enable ? (long)(TARGET_FPS * 1000000000.0) : 0;
+
+        struct itimerspec spec = {
+                .it_interval = { .tv_sec = 0, .tv_nsec = interval },
+                .it_value = { .tv_sec = 0, .tv_nsec = interval },
+        };
+
+        timerfd_settime(fd, 0, &spec, NULL);
+}
+
+/**
+ * Run the main loop until the editor is closed.
+ *
+ * @param int signal_fd - The descriptor returned by init_signals.
+ * */
+void run(int signal_fd) {
+	// Drives screens which always update (SCR_OPT_ALWAYS)
+        int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        bool animating = 0;
+
+        struct pollfd fds[AS_FD_COUNT] = {
+                [AS_FD_INPUT]  = { .fd = STDIN_FILENO, .events = POLLIN },
+                [AS_FD_SIGNAL] = { .fd = signal_fd,    .events = POLLIN },
+                [AS_FD_TIMER]  = { .fd = timer_fd,     .events = POLLIN },
+                [AS_FD_SYNTAX] = { .fd = syntax_fd(),  .events = POLLIN },
+        };
+
+	// "Wake-up" cycle
+	editor();
+	interface();
+
+        while (running) {
+                bool render = 0;
+
+		// Only keep the timer running while the screen needs it
+                bool always = as_ctx.screen != NULL && (as_ctx.screen->render_options & SCR_OPT_ALWAYS);
+
+                if (always != animating) {
+                        arm_timer(timer_fd, always);
+                        animating = always;
+                }
+
+		// Sleep until there is input, a signal, a frame is due,
+		// lines have been highlighted, or a key sequence times out
+                if (poll(fds, AS_FD_COUNT, keyboard_timeout()) < 0) {
+                        continue;
+                }
+
+                if (fds[AS_FD_SIGNAL].revents & POLLIN) {
+                        render |= handle_signals(signal_fd);
+                }
+
+                if (fds[AS_FD_TIMER].revents & POLLIN) {
+                        uint64_t expirations = 0;
+                        read(timer_fd, &expirations, sizeof(expirations));
+
+                        render = 1;
+                }
+
+		// Handles input, and applies highlighted lines
+                editor();
+
+                if (running && (render || update)) {
+			interface();
+                }
+
+                update = 0;
+        }
+
+        close(timer_fd);
 }
 
 /**
- * Function to be called when SIGINT is received.
+ * Copy a file to replay a trace against, so that saves in the trace
+ * leave the file as it was.
+ *
+ * The copy is made in the temporary directory, and ends in the name
+ * of the file so that it is highlighted the same way.
+ *
+ * @param char *name - The file.
+ * @return The path of the copy, which the caller unlinks and frees, NULL if it could not be made.
  * */
-void terminate(int signal) {
-        running = 0;
+char *copy_replay_file(char *name) {
+	char *base = strrchr(name, '/');
+	base = (base != NULL) ? base + 1 : name;
+
+	char *directory = getenv("TMPDIR");
+	directory = (directory != NULL && *directory != 0) ? directory : "/tmp";
+
+	char *copy = (char *)malloc(strlen(directory) + strlen(base) + 32);
+	sprintf(copy, "%s/assembled-replay-XXXXXX-%s", directory, base);
+
+	int in = open(name, O_RDONLY);
+	int out = (in != -1) ? mkstemps(copy, strlen(base) + 1) : -1;
+
+	char buffer[65536];
+	ssize_t length = 0;
+
+	while (out != -1 && (length = read(in, buffer, sizeof(buffer))) > 0) {
+		if (write(out, buffer, length) != length) {
+			length = -1;
+
+			break;
+		}
+	}
+
+	if (in != -1) {
+		close(in);
+	}
+
+	if (out != -1) {
+		close(out);
+	}
+
+	if (out == -1 || length < 0) {
+		if (out != -1) {
+			unlink(copy);
+		}
+
+		free(copy);
+
+		return NULL;
+	}
+
+	return copy;
+}
+
+/**
+ * Replay a trace as fast as possible.
+ *
+ * Keys are handled exactly as in the main loop, those read in the same
+ * frame when the trace was recorded are handled in the same frame. The
+ * keyboard's clock is pinned to the time each key was recorded at, so
+ * incomplete key sequences time out where they did when recording. The
+ * time taken by every phase is added to its log.
+ *
+ * @param struct AS_Trace *trace - The trace to replay.
+ * @param struct AS_LatencyLog *phases - A log for every AS_REPLAY_PHASES.
+ * */
+void replay(struct AS_Trace *trace, struct AS_LatencyLog *phases) {
+	// "Wake-up" cycle
+	update_screen();
+	interface();
+
+	for (int i = 0; i < trace->count && running;) {
+		int current = trace->keys[i].frame;
+		uint64_t frame_start = trace_now();
+
+		// Give up on a key sequence which had timed out by the
+		// time this frame was read
+		trace_pin_clock(trace->keys[i].time * 1000);
+
+		uint64_t start = trace_now();
+
+		if (keyboard_tick()) {
+			latency_add(&phases[AS_REPLAY_LOCAL], trace_now() - start);
+		}
+
+		for (; i < trace->count && trace->keys[i].frame == current; i++) {
+			trace_pin_clock(trace->keys[i].time * 1000);
+
+			start = trace_now();
+			handle_key(trace->keys[i].code);
+			latency_add(&phases[AS_REPLAY_LOCAL], trace_now() - start);
+		}
+
+		start = trace_now();
+		update_screen();
+		latency_add(&phases[AS_REPLAY_UPDATE], trace_now() - start);
+
+		start = trace_now();
+		draw_screen();
+		latency_add(&phases[AS_REPLAY_RENDER], trace_now() - start);
+
+		start = trace_now();
+		refresh();
+		latency_add(&phases[AS_REPLAY_REFRESH], trace_now() - start);
+
+		latency_add(&phases[AS_REPLAY_FRAME], trace_now() - frame_start);
+		profile_frame();
+
+		update = 0;
+	}
 }
 
 int main(int argc, char **argv) {
@@ -167,8 +541,52 @@ int main(int argc, char **argv) {
                 }
         )
 
+	// Read the command line
+	char *file_name = NULL;
+	char *record_path = NULL;
+	char *replay_path = NULL;
+	int layout = -1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay_path = argv[++i];
+		} else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+			layout = atoi(argv[++i]);
+		} else if (strncmp(argv[i], "--", 2) == 0) {
+			printf("Usage: %s [--record TRACE] [--replay TRACE] [--layout N] [FILE]\n", argv[0]);
+
+			return 1;
+		} else {
+			file_name = argv[i];
+		}
+	}
+
+	struct AS_Trace trace = { 0 };
+
+	if (replay_path != NULL && (file_name == NULL || trace_load(replay_path, &trace) == -1)) {
+		printf("A trace (%s) and a file to replay it against are needed to replay\n", replay_path);
+
+		return 1;
+	}
+
+	// Every replay starts from the same contents
+	char *replay_file = NULL;
+
+	if (replay_path != NULL && (replay_file = copy_replay_file(file_name)) == NULL) {
+		printf("Failed to copy %s to replay against\n", file_name);
+
+		return 1;
+	}
+
 	// Initialize
 	as_ctx.col_desc_i = -1;
+	as_ctx.undo_limit = AS_UNDO_DEFAULT_LIMIT;
+	as_ctx.file_mask = umask(0);
+	umask(as_ctx.file_mask);
+
+        int signal_fd = init_signals();
 
         read_config();
 	init_syntax();
@@ -194,75 +612,82 @@ int main(int argc, char **argv) {
                 as_ctx.col_descs[as_ctx.col_desc_i].delimiter = 0;
         }
 
+	if (layout != -1) {
+		// A layout was asked for on the command line
+		if (layout < 0 || layout >= AS_MAX_COLUMNS || as_ctx.col_descs[layout].column_count <= 0) {
+			printf("Layout %d is not defined\n", layout);
+
+			return 1;
+		}
+
+		as_ctx.col_desc_i = layout;
+	}
+
 	// Register screens
         register_start_screen();
         register_editor_screen();
         register_file_load_scr();
 
 	// Check for file to load
-        if (argc > 1) {
-                load_file(argv[1]);
+        if (file_name != NULL) {
+                load_file((replay_file != NULL) ? replay_file : file_name);
                 switch_to_screen("editor");
         } else {
                 switch_to_screen("start");
         }
 
-	// Allow program to terminate properly on Ctrl + C
-        signal(SIGINT, terminate);
+        if (record_path != NULL && trace_record_start(record_path) == -1) {
+                printf("Failed to open %s to record to\n", record_path);
 
-        init_ncurses();
+                return 1;
+        }
+
+        init_ncurses(replay_path != NULL);
 
 	// Initialization is complete
 	// Get to running
+	struct AS_LatencyLog phases[AS_REPLAY_PHASE_COUNT] = { 0 };
 
-        struct timespec spec;
-        clock_gettime(CLOCK_REALTIME, &spec);
-
-        double now = 0;
-        double last = spec.tv_nsec / 1000000000.0;
-        double delta = 0;
-        double accumulator = 0;
-
-	// "Wake-up" cycle
-	editor();
-	interface();
+	if (replay_path != NULL) {
+		replay(&trace, phases);
+	} else {
+		run(signal_fd);
+	}
 
-        while (running) {
-                bool render = 0;
+	// Shutdown
+	stop_syntax();
+	trace_record_stop();
 
-                clock_gettime(CLOCK_REALTIME, &spec);
-                now = spec.tv_nsec / 1000000000.0;
-                delta = now - last;
-                last = now;
-                accumulator += fabs(delta);
+        close(signal_fd);
 
-                while (accumulator >= TARGET_FPS) {
-                        editor();
+	// Stop ncurses window
+	if (replay_path == NULL) {
+		printf("\033[?2004l");
+		fflush(stdout);
+	}
 
-                        if (update == 0) {
-				// No update, don't need to render
-                                accumulator = 0;
-                                break;
-                        }
+        endwin();
 
-                        accumulator -= TARGET_FPS;
-                        render = 1;
-                }
+	if (replay_path != NULL) {
+		// Report how long each phase took
+		printf("{\n\t\"trace\": \"%s\",\n\t\"file\": \"%s\",\n\t\"layout\": %d,\n\t\"keys\": %d,\n\t\"phases\": [\n",
+		       replay_path, file_name, as_ctx.col_desc_i, trace.count);
 
-		// Probably impossible to type a character in an
-		// interval below ~8 milliseconds
-                usleep(8000);
+		for (int i = 0; i < AS_REPLAY_PHASE_COUNT; i++) {
+			printf("\t\t");
+			latency_report(stdout, (char *)replay_phase_names[i], &phases[i]);
+			printf("%s\n", (i + 1 < AS_REPLAY_PHASE_COUNT) ? "," : "");
 
-                if (render || (as_ctx.screen->render_options & SCR_OPT_ALWAYS)) {
-			interface();
-                }
+			latency_destroy(&phases[i]);
+		}
 
-                update = 0;
-        }
+		printf("\t]\n}\n");
+		trace_destroy(&trace);
 
-	// Shutdown
-	// Stop ncurses window
-        endwin();
+		// Memory Manage
+		unlink(replay_file);
+		free(replay_file);
+	}
 
         AS_DEBUG_MSG("Successfuly exited\n");
 
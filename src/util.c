@@ -28,6 +28,9 @@
 #include <global.h>
 #include <util.h>
 
+#include <errno.h>
+#include <pthread.h>
+
 uint64_t general_hash(char *string) {
         uint64_t hash = 5381;
 
@@ -100,3 +103,223 @@ char *fpath2abs(char *path, int options) {
 
 	return final;
 }
+
+void *arena_alloc(struct AS_Arena *arena, size_t size) {
+	// Keep allocations 8 byte aligned
+	size = (size + 7) & ~(size_t)7;
+
+	if (arena->head == NULL || arena->head->used + size > arena->head->size) {
+		// Current chunk is full, start a new one
+		size_t chunk_size = max(size, (size_t)AS_ARENA_CHUNK_SIZE);
+		struct AS_ArenaChunk *chunk = (struct AS_ArenaChunk *)malloc(sizeof(struct AS_ArenaChunk) + chunk_size);
+
+		chunk->next = arena->head;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		arena->head = chunk;
+		arena->size += chunk_size;
+	}
+
+	void *pointer = arena->head->data + arena->head->used;
+	arena->head->used += size;
+
+	return pointer;
+}
+
+void arena_reset(struct AS_Arena *arena) {
+	if (arena->head == NULL) {
+		return;
+	}
+
+	// Free every chunk but the first
+	while (arena->head->next != NULL) {
+		struct AS_ArenaChunk *tmp = arena->head;
+		arena->head = arena->head->next;
+
+		free(tmp);
+	}
+
+	arena->head->used = 0;
+	arena->size = arena->head->size;
+}
+
+void arena_destroy(struct AS_Arena *arena) {
+	while (arena->head != NULL) {
+		struct AS_ArenaChunk *tmp = arena->head;
+		arena->head = arena->head->next;
+
+		free(tmp);
+	}
+
+	arena->size = 0;
+}
+
+/// Set on the threads of the worker pool, whose own parallel_runs are run inline.
+static __thread bool parallel_thread = 0;
+
+/**
+ * The worker pool shared by every parallel_run.
+ * */
+struct AS_WorkerPool {
+	/// Held by the caller of parallel_run for the whole run, one run uses the pool at a time.
+	pthread_mutex_t run;
+	/// Protects everything below.
+	pthread_mutex_t lock;
+	/// Signaled when there are jobs to start.
+	pthread_cond_t work;
+	/// Signaled when the last job of a run is finished.
+	pthread_cond_t finished;
+	/// The number of threads in the pool, 0 until it is started.
+	int workers;
+	/// The function run for every job.
+	void (*job)(void *, int);
+	/// Passed to every job.
+	void *argument;
+	/// The number of jobs.
+	int count;
+	/// The index of the next job to be started.
+	int next;
+	/// The number of jobs which are finished.
+	int done;
+};
+
+static struct AS_WorkerPool pool = {
+	.run = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.finished = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * A thread of the worker pool.
+ *
+ * Waits for jobs, and runs them as long as there are any to start.
+ * Never returns, the pool lasts until the editor exits.
+ *
+ * @param void *argument - Unused.
+ * */
+static void *parallel_worker(void *argument) {
+	parallel_thread = 1;
+
+	pthread_mutex_lock(&pool.lock);
+
+	while (1) {
+		while (pool.next >= pool.count) {
+			pthread_cond_wait(&pool.work, &pool.lock);
+		}
+
+		int i = pool.next++;
+		void (*job)(void *, int) = pool.job;
+		void *job_argument = pool.argument;
+
+		// Work without holding the lock
+		pthread_mutex_unlock(&pool.lock);
+		job(job_argument, i);
+		pthread_mutex_lock(&pool.lock);
+
+		if (++pool.done == pool.count) {
+			pthread_cond_signal(&pool.finished);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Start the threads of the worker pool, a thread per processor.
+ *
+ * Must be called holding pool.run.
+ * */
+static void start_pool() {
+	int count = parallel_workers();
+
+	while (pool.workers < count) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, parallel_worker, NULL) != 0) {
+			break;
+		}
+
+		pthread_detach(thread);
+		pool.workers++;
+	}
+
+	AS_DEBUG_MSG("Started %d of %d workers\n", pool.workers, count);
+}
+
+int parallel_workers() {
+	if (parallel_thread) {
+		// Already on a worker, every processor is taken
+		return 1;
+	}
+
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (int)min(max(processors, 1L), (long)AS_MAX_WORKERS);
+}
+
+void parallel_run(int count, void (*job)(void *, int), void *argument, char *action) {
+	if (min(count, parallel_workers()) <= 1) {
+		// Threads would only add overhead
+		for (int i = 0; i < count; i++) {
+			job(argument, i);
+		}
+
+		return;
+	}
+
+	pthread_mutex_lock(&pool.run);
+
+	if (pool.workers == 0) {
+		start_pool();
+	}
+
+	if (pool.workers == 0) {
+		AS_DEBUG_MSG("No workers, running %d jobs serially\n", count);
+		pthread_mutex_unlock(&pool.run);
+
+		for (int i = 0; i < count; i++) {
+			job(argument, i);
+		}
+
+		return;
+	}
+
+	// Hand the jobs to the pool
+	pthread_mutex_lock(&pool.lock);
+
+	pool.job = job;
+	pool.argument = argument;
+	pool.count = count;
+	pool.next = 0;
+	pool.done = 0;
+
+	pthread_cond_broadcast(&pool.work);
+
+	// Wait for the jobs, reporting progress if they take a while
+	while (pool.done < count) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+
+		deadline.tv_nsec += AS_PROGRESS_INTERVAL * 1000000L;
+		deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+
+		if (pthread_cond_timedwait(&pool.finished, &pool.lock, &deadline) == ETIMEDOUT && action != NULL && as_ctx.progress != NULL) {
+			int done = pool.done;
+
+			// Don't hold up the workers while drawing
+			pthread_mutex_unlock(&pool.lock);
+			as_ctx.progress(action, done, count);
+			pthread_mutex_lock(&pool.lock);
+		}
+	}
+
+	// Nothing is left for the workers to start
+	pool.count = 0;
+	pool.next = 0;
+
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.run);
+}